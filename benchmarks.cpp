@@ -0,0 +1,684 @@
+#include "headers/benchmarks.h"
+#include "headers/bezier.h"
+#include "headers/bvh.h"
+#include "headers/cloth_solver.h"
+#include "headers/entity_store.h"
+#include "headers/frame_stats.h"
+#include "headers/geometry_arena.h"
+#include "headers/indirect_renderer.h"
+#include "headers/model.h"
+#include "headers/model_cache.h"
+#include "headers/render_queue.h"
+#include "headers/Sphere.h"
+#include "headers/thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+// FNV-1a over the bits of the positions, equal hashes mean bitwise identical simulations
+static unsigned long long hashPositions(const ClothSolver& solver)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	for (int i = 0; i < solver.getParticleCount(); i++)
+	{
+		glm::vec3 position = solver.getPosition(i);
+		unsigned int bits[3];
+		std::memcpy(bits, &position[0], sizeof(bits));
+		for (int k = 0; k < 3; k++)
+		{
+			hash ^= bits[k];
+			hash *= 1099511628211ULL;
+		}
+	}
+	return hash;
+}
+
+int runClothBenchmark()
+{
+	const int particleCounts[] = { 1000, 10000, 100000 };
+	const int threadCounts[] = { 1, 2, 4, 8 };
+	// steps simulated from rest before the positions are compared between thread counts
+	const int checkedSteps = 60;
+	const float step = 1.0f / 120.0f;
+
+	ClothWind wind;
+	wind.direction = glm::vec3(1.0f, 0.0f, 0.0f);
+	wind.strength = 25.0f;
+	wind.flutter = 8.0f;
+	wind.freq = 2.0f;
+	wind.speed = 1.0f;
+
+	bool deterministic = true;
+	for (int particles : particleCounts)
+	{
+		int side = (int)std::sqrt((float)particles);
+		unsigned long long referenceHash = 0;
+
+		for (int threads : threadCounts)
+		{
+			ThreadPool pool(threads);
+			ClothSolver solver(side, side, 1.6f, 1.0f);
+			solver.pinColumn(0);
+			solver.setThreadPool(&pool);
+
+			float time = 0.0f;
+			for (int i = 0; i < checkedSteps; i++, time += step)
+				solver.step(step, time, wind);
+
+			unsigned long long hash = hashPositions(solver);
+			if (threads == 1)
+				referenceHash = hash;
+			bool identical = hash == referenceHash;
+			deterministic = deterministic && identical;
+
+			// at least one second and 20 steps
+			typedef std::chrono::steady_clock clock;
+			clock::time_point start = clock::now();
+			double elapsed = 0.0;
+			int steps = 0;
+			while (elapsed < 1.0 || steps < 20)
+			{
+				solver.step(step, time, wind);
+				time += step;
+				steps++;
+				elapsed = std::chrono::duration<double>(clock::now() - start).count();
+			}
+
+			std::cout << "cloth: " << solver.getParticleCount() << " particles, " << solver.getConstraintCount()
+				<< " constraints in " << solver.getBatchCount() << " batches, " << threads << " threads: "
+				<< steps / elapsed << " steps/s (" << elapsed * 1000.0 / steps << " ms/step), "
+				<< pool.getStealCount() << " steals, " << (identical ? "identical" : "DIFFERENT") << std::endl;
+		}
+	}
+
+	std::cout << "cloth: results " << (deterministic ? "bitwise identical" : "NOT identical")
+		<< " for 1, 2, 4 and 8 threads after " << checkedSteps << " steps" << std::endl;
+	return deterministic ? 0 : 1;
+}
+
+// seconds to construct the model, without the time spent on its textures
+static double timeModelLoad(const std::string& path, bool& fromCache)
+{
+	typedef std::chrono::steady_clock clock;
+	clock::time_point start = clock::now();
+	// same layout and retention as the backpack in the scene, so the cache left behind is the one the scene reads
+	VertexLayout layout;
+	layout.tangents = false;
+	Model model(path, false, layout, NULL, GEOMETRY_DROP);
+	glFinish();
+	double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+	fromCache = model.loadedFromCache;
+	return elapsed - model.textureLoadTime;
+}
+
+int runModelLoadBenchmark(const std::string& path)
+{
+	const int runs = 3;
+	std::string cachePath = ModelCache::cachePath(path);
+	double cold = 0.0, warm = 0.0;
+	bool fromCache = false;
+
+	// cold: the cache is deleted before every run, so each one imports with assimp and writes a new cache
+	for (int i = 0; i < runs; i++)
+	{
+		std::remove(cachePath.c_str());
+		cold += timeModelLoad(path, fromCache);
+		if (fromCache)
+		{
+			std::cout << "model load: " << cachePath << " could not be removed" << std::endl;
+			return 1;
+		}
+	}
+
+	// warm: the cache written by the last cold run is mapped
+	for (int i = 0; i < runs; i++)
+	{
+		warm += timeModelLoad(path, fromCache);
+		if (!fromCache)
+		{
+			std::cout << "model load: " << cachePath << " was not used" << std::endl;
+			return 1;
+		}
+	}
+
+	cold /= runs;
+	warm /= runs;
+	std::cout << "model load: " << path << ", average of " << runs << " runs without textures: cold (assimp + cache write) "
+		<< cold * 1000.0 << " ms, warm (cache) " << warm * 1000.0 << " ms, " << cold / warm << "x faster" << std::endl;
+	return 0;
+}
+
+// the sphere's interleaved position, normal and uv floats as Vertex, added to the arena
+static GeometryRange addSphere(GeometryArena& arena, const Sphere& sphere)
+{
+	const float* data = sphere.getInterleavedVertices();
+	unsigned int floatsPerVertex = sphere.getInterleavedStride() / sizeof(float);
+	std::vector<Vertex> vertices(sphere.getInterleavedVertexCount(), Vertex());
+	for (unsigned int i = 0; i < vertices.size(); i++, data += floatsPerVertex)
+	{
+		vertices[i].Position = glm::vec3(data[0], data[1], data[2]);
+		vertices[i].Normal = glm::vec3(data[3], data[4], data[5]);
+		vertices[i].TexCoords = glm::vec2(data[6], data[7]);
+	}
+	return arena.add(vertices.data(), (unsigned int)vertices.size(), sphere.getIndices(), sphere.getIndexCount());
+}
+
+// average CPU time of collecting and submitting one frame of the objects, with the GL calls it took
+static double timeIndirectFrames(IndirectRenderer& indirect, Renderer& renderer, const FrameState& frame, Shader* shaders[2],
+	GeometryArena& arena, const GeometryRange geometries[2], const std::vector<glm::mat4>& models, unsigned int& glCalls)
+{
+	// both spheres have a radius of 0.4, the grid is entirely in view so the culling test runs but drops nothing
+	BoundingBox bounds;
+	bounds.add(glm::vec3(-0.4f));
+	bounds.add(glm::vec3(0.4f));
+	typedef std::chrono::steady_clock clock;
+	const int warmupFrames = 10, frames = 200;
+	double elapsed = 0.0;
+	for (int i = 0; i < warmupFrames + frames; i++)
+	{
+		frameStats.reset();
+		clock::time_point start = clock::now();
+		renderer.beginFrame(frame);
+		indirect.begin(frame);
+		for (size_t k = 0; k < models.size(); k++)
+		{
+			// two programs and two meshes, so there are two buckets with both meshes in each
+			indirect.setState(*shaders[k % 2], arena);
+			indirect.add(geometries[(k / 2) % 2], bounds, models[k]);
+		}
+		indirect.flush();
+		if (i >= warmupFrames)
+			elapsed += std::chrono::duration<double>(clock::now() - start).count();
+		// the GPU catches up outside the measured time, so the queue does not fill up
+		glFinish();
+	}
+	glCalls = frameStats.glCalls;
+	return elapsed * 1000.0 / frames;
+}
+
+int runIndirectDrawBenchmark(int objects, GLADloadproc loader)
+{
+	Shader containerShader("shaders/container_shader.vs", "shaders/container_shader.fs");
+	Shader sphereShader("shaders/sphere_shader.vs", "shaders/sphere_shader.fs");
+	Shader* shaders[2] = { &containerShader, &sphereShader };
+	for (int i = 0; i < 2; i++)
+	{
+		shaders[i]->bindUniformBlock("FrameData", FRAME_UBO_BINDING);
+		shaders[i]->bindUniformBlock("LightData", LIGHT_UBO_BINDING);
+		shaders[i]->use();
+		shaders[i]->setInt("drawData", IndirectRenderer::DRAW_DATA_UNIT);
+	}
+
+	VertexLayout layout;
+	layout.tangents = false;
+	GeometryArena& arena = geometryArenas.get(layout);
+	GeometryRange geometries[2] = { addSphere(arena, Sphere(0.4f, 36, 18)), addSphere(arena, Sphere(0.4f, 12, 6)) };
+
+	// a square grid in front of the camera
+	int side = (int)std::ceil(std::sqrt((float)objects));
+	std::vector<glm::mat4> models(objects);
+	for (int i = 0; i < objects; i++)
+		models[i] = glm::translate(glm::mat4(1.0f), glm::vec3((float)(i % side - side / 2), (float)(i / side - side / 2), -1.5f * side));
+
+	FrameState frame = FrameState();
+	frame.view = glm::mat4(1.0f);
+	frame.projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 4.0f * side);
+	frame.viewProjection = frame.projection;
+	Renderer renderer;
+	glEnable(GL_DEPTH_TEST);
+
+	IndirectRenderer indirect(loader);
+	unsigned int fallbackCalls = 0, multiDrawCalls = 0;
+	indirect.setMultiDraw(false);
+	double fallback = timeIndirectFrames(indirect, renderer, frame, shaders, arena, geometries, models, fallbackCalls);
+	std::cout << "indirect: " << objects << " objects in " << indirect.getBucketCount() << " buckets on " << glGetString(GL_RENDERER)
+		<< ", fallback " << fallback << " ms/frame (" << fallbackCalls << " gl calls)";
+	if (indirect.isMultiDrawSupported())
+	{
+		indirect.setMultiDraw(true);
+		double multiDraw = timeIndirectFrames(indirect, renderer, frame, shaders, arena, geometries, models, multiDrawCalls);
+		std::cout << ", multi draw " << multiDraw << " ms/frame (" << multiDrawCalls << " gl calls), " << fallback / multiDraw << "x faster";
+	}
+	else
+		std::cout << ", multi draw not supported";
+	std::cout << std::endl;
+
+	arena.remove(geometries[0]);
+	arena.remove(geometries[1]);
+	return 0;
+}
+
+// random boxes with sides from 0.5 to 1.5, centers in a cube of the given side
+static void randomBoxes(std::mt19937& random, float side, std::vector<BoundingBox>& boxes)
+{
+	std::uniform_real_distribution<float> position(0.0f, side), size(0.25f, 0.75f);
+	for (size_t i = 0; i < boxes.size(); i++)
+	{
+		glm::vec3 center(position(random), position(random), position(random));
+		glm::vec3 extents(size(random), size(random), size(random));
+		boxes[i] = BoundingBox();
+		boxes[i].add(center - extents);
+		boxes[i].add(center + extents);
+	}
+}
+
+// nearest box along the ray by testing every one of them
+static int intersectRayLinear(const std::vector<BoundingBox>& boxes, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance)
+{
+	glm::vec3 inverseDirection = 1.0f / direction;
+	int hit = -1;
+	distance = maxDistance;
+	for (size_t i = 0; i < boxes.size(); i++)
+	{
+		float enter;
+		if (boxes[i].intersectsRay(origin, inverseDirection, distance, enter) && (enter < distance || hit < 0))
+		{
+			distance = enter;
+			hit = (int)i;
+		}
+	}
+	return hit;
+}
+
+int runBvhBenchmark()
+{
+	const unsigned int objectCounts[] = { 10000, 100000, 1000000 };
+	// rays through the tree, and the ones also tested against every box to check the answers
+	const int rays = 10000, checkedRays = 100;
+	const int cullRuns = 20, updates = 10000;
+	typedef std::chrono::steady_clock clock;
+
+	bool identical = true;
+	for (unsigned int count : objectCounts)
+	{
+		// about one box per hundred units of volume at every count, seen from the middle of the cube
+		float side = std::cbrt(100.0f * count);
+		std::mt19937 random(1234);
+		std::vector<BoundingBox> boxes(count);
+		randomBoxes(random, side, boxes);
+		glm::vec3 eye = glm::vec3(0.5f * side);
+		glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 0.5f * side)
+			* glm::lookAt(eye, eye + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		Frustum frustum(viewProjection);
+
+		Bvh bvh;
+		clock::time_point start = clock::now();
+		bvh.build(boxes.data(), count);
+		double build = std::chrono::duration<double>(clock::now() - start).count();
+
+		// every box moved a little, the tree keeps its shape
+		std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			glm::vec3 move(offset(random), offset(random), offset(random));
+			boxes[i].min += move;
+			boxes[i].max += move;
+		}
+		start = clock::now();
+		bvh.refit(boxes.data());
+		double refit = std::chrono::duration<double>(clock::now() - start).count();
+
+		// single objects moved, as the orbiting container is every frame
+		std::uniform_int_distribution<unsigned int> object(0, count - 1);
+		std::vector<unsigned int> moved(updates);
+		for (int i = 0; i < updates; i++)
+		{
+			moved[i] = object(random);
+			glm::vec3 move(offset(random), offset(random), offset(random));
+			boxes[moved[i]].min += move;
+			boxes[moved[i]].max += move;
+		}
+		start = clock::now();
+		for (int i = 0; i < updates; i++)
+			bvh.update(moved[i], boxes[moved[i]]);
+		double update = std::chrono::duration<double>(clock::now() - start).count() / updates;
+
+		std::vector<unsigned int> visible;
+		start = clock::now();
+		for (int i = 0; i < cullRuns; i++)
+		{
+			visible.clear();
+			bvh.cull(frustum, visible);
+		}
+		double cull = std::chrono::duration<double>(clock::now() - start).count() / cullRuns;
+
+		// the per draw test of the IndirectRenderer over the same boxes
+		BoxCuller culler;
+		culler.reserve(count);
+		for (size_t i = 0; i < boxes.size(); i++)
+			culler.add(boxes[i]);
+		std::vector<unsigned char> visibleFlags;
+		size_t linearVisible = 0;
+		start = clock::now();
+		for (int i = 0; i < cullRuns; i++)
+			linearVisible = culler.test(frustum, visibleFlags);
+		double linearCull = std::chrono::duration<double>(clock::now() - start).count() / cullRuns;
+		size_t expectedVisible = 0;
+		for (size_t i = 0; i < boxes.size(); i++)
+			expectedVisible += frustum.intersects(boxes[i]) ? 1 : 0;
+		bool same = visible.size() == expectedVisible;
+
+		// rays from random points of the cube in random directions
+		std::vector<glm::vec3> origins(rays), directions(rays);
+		for (int i = 0; i < rays; i++)
+		{
+			origins[i] = glm::vec3(offset(random), offset(random), offset(random)) * 0.5f * side + eye;
+			directions[i] = glm::normalize(glm::vec3(offset(random), offset(random), offset(random)) + glm::vec3(1e-3f));
+		}
+		std::vector<int> hits(rays);
+		std::vector<float> distances(rays, 0.0f);
+		start = clock::now();
+		for (int i = 0; i < rays; i++)
+			hits[i] = bvh.intersectRay(origins[i], directions[i], side, distances[i]);
+		double ray = std::chrono::duration<double>(clock::now() - start).count() / rays;
+
+		start = clock::now();
+		for (int i = 0; i < checkedRays; i++)
+		{
+			float distance;
+			int hit = intersectRayLinear(boxes, origins[i], directions[i], side, distance);
+			// two boxes entered at the same distance may be answered either way
+			same = same && (hit < 0) == (hits[i] < 0) && (hit < 0 || distance == distances[i]);
+		}
+		double linearRay = std::chrono::duration<double>(clock::now() - start).count() / checkedRays;
+		identical = identical && same;
+
+		std::cout << "bvh: " << count << " objects, " << bvh.getNodeCount() << " nodes, build " << build * 1000.0 << " ms, refit "
+			<< refit * 1000.0 << " ms, update " << update * 1e6 << " us, cull " << cull * 1000.0 << " ms (" << visible.size()
+			<< " visible, linear SSE " << linearCull * 1000.0 << " ms, " << linearVisible << " visible), ray " << ray * 1e6
+			<< " us (linear " << linearRay * 1e6 << " us), " << (same ? "identical" : "DIFFERENT") << std::endl;
+	}
+
+	std::cout << "bvh: results " << (identical ? "identical" : "NOT identical") << " to testing every box" << std::endl;
+	return identical ? 0 : 1;
+}
+
+// one object with all of its data together, as scene objects were kept before the EntityStore
+struct EntityBenchmarkObject
+{
+	Transform transform;
+	glm::mat4 world;
+	MeshRef mesh;
+	Material material;
+	Light light;
+	Animator animator;
+};
+
+int runEntityBenchmark(int count)
+{
+	const int warmupFrames = 5, frames = 100;
+	const float step = 1.0f / 60.0f;
+	const unsigned int meshes = 4;
+	typedef std::chrono::steady_clock clock;
+
+	EntityStore entities;
+	const unsigned int components = TRANSFORM_COMPONENT | MESH_COMPONENT | MATERIAL_COMPONENT | ANIMATOR_COMPONENT;
+	entities.reserve(components, count);
+	std::vector<EntityBenchmarkObject> objects(count);
+	for (int i = 0; i < count; i++)
+	{
+		Entity entity = entities.create(components);
+		Animator animator = { 1.0f + (float)(i % 100), (float)(i / 100 % 100), 0.5f + 0.01f * (float)(i % 50), 0.1f * (float)i };
+		entities.animator(entity) = animator;
+		entities.mesh(entity).mesh = i % meshes;
+		entities.material(entity).parameters = glm::vec4(1.0f, 1.0f, 1.0f, 0.25f * (float)(i % 4));
+
+		EntityBenchmarkObject& object = objects[i];
+		object.transform = entities.transform(entity);
+		object.world = glm::mat4(1.0f);
+		object.mesh = entities.mesh(entity);
+		object.material = entities.material(entity);
+		object.light = Light();
+		object.animator = animator;
+	}
+
+	// animation and model matrices of every entity
+	double update = 0.0;
+	for (int frame = 0; frame < warmupFrames + frames; frame++)
+	{
+		clock::time_point start = clock::now();
+		entities.animate(step);
+		entities.updateTransforms();
+		if (frame >= warmupFrames)
+			update += std::chrono::duration<double>(clock::now() - start).count();
+	}
+	update /= frames;
+
+	// the same work over the objects, one loop per system like the store
+	double objectUpdate = 0.0;
+	const float fullTurn = 2.0f * glm::pi<float>();
+	for (int frame = 0; frame < warmupFrames + frames; frame++)
+	{
+		clock::time_point start = clock::now();
+		for (int i = 0; i < count; i++)
+		{
+			Animator& animator = objects[i].animator;
+			animator.angle = std::fmod(animator.angle + animator.speed * step, fullTurn);
+			float halfCos = std::cos(0.5f * animator.angle), halfSin = std::sin(0.5f * animator.angle);
+			objects[i].transform.position = glm::vec3(animator.radius * (halfCos * halfCos - halfSin * halfSin), animator.height,
+				animator.radius * 2.0f * halfSin * halfCos);
+			objects[i].transform.rotation = glm::quat(halfCos, 0.0f, -halfSin, 0.0f);
+		}
+		for (int i = 0; i < count; i++)
+		{
+			const Transform& transform = objects[i].transform;
+			glm::mat3 rotation = glm::mat3_cast(transform.rotation);
+			objects[i].world[0] = glm::vec4(rotation[0] * transform.scale.x, 0.0f);
+			objects[i].world[1] = glm::vec4(rotation[1] * transform.scale.y, 0.0f);
+			objects[i].world[2] = glm::vec4(rotation[2] * transform.scale.z, 0.0f);
+			objects[i].world[3] = glm::vec4(transform.position, 1.0f);
+		}
+		if (frame >= warmupFrames)
+			objectUpdate += std::chrono::duration<double>(clock::now() - start).count();
+	}
+	objectUpdate /= frames;
+
+	DrawList list;
+	double drawList = 0.0;
+	for (int frame = 0; frame < warmupFrames + frames; frame++)
+	{
+		clock::time_point start = clock::now();
+		list.clear();
+		entities.buildDrawList(list);
+		if (frame >= warmupFrames)
+			drawList += std::chrono::duration<double>(clock::now() - start).count();
+	}
+	drawList /= frames;
+
+	unsigned int listed = 0;
+	for (unsigned int mesh = 0; mesh < meshes; mesh++)
+		listed += list.getInstanceCount(mesh);
+	// bytes read and written per entity: animator and transform both ways and the matrix written; the draw list
+	// reads the matrix, mesh and material and writes the matrix and material
+	double updateBytes = 2.0 * (sizeof(Animator) + sizeof(Transform)) + sizeof(glm::mat4);
+	double drawListBytes = sizeof(glm::mat4) + sizeof(MeshRef) + sizeof(Material) + sizeof(glm::mat4) + sizeof(glm::vec4);
+	std::cout << "entities: " << count << " in " << entities.getArchetypeCount() << " archetype, transform update "
+		<< update * 1000.0 << " ms (" << count / update / 1e6 << " M/s, " << count * updateBytes / update / 1e9 << " GB/s), one struct per object "
+		<< objectUpdate * 1000.0 << " ms (" << objectUpdate / update << "x), draw list " << drawList * 1000.0 << " ms ("
+		<< count / drawList / 1e6 << " M/s, " << count * drawListBytes / drawList / 1e9 << " GB/s, " << listed << " instances in "
+		<< meshes << " meshes)" << std::endl;
+	return listed == (unsigned int)count ? 0 : 1;
+}
+
+int runRenderQueueBenchmark(int count)
+{
+	const int warmupFrames = 5, frames = 50;
+	const unsigned int shaders = 8, materials = 64, vertexArrays = 4;
+	typedef std::chrono::steady_clock clock;
+
+	// draws in random order, one in five transparent
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<unsigned int> shader(0, shaders - 1), material(0, materials - 1), vertexArray(0, vertexArrays - 1);
+	std::uniform_real_distribution<float> depth(0.1f, 100.0f), chance(0.0f, 1.0f);
+	std::vector<uint64_t> keys(count);
+	std::vector<float> depths(count);
+	for (int i = 0; i < count; i++)
+	{
+		RenderPass pass = chance(random) < 0.2f ? TRANSPARENT_PASS : OPAQUE_PASS;
+		depths[i] = depth(random);
+		keys[i] = RenderQueue::makeKey(pass, shader(random), material(random), vertexArray(random), depths[i]);
+	}
+
+	RenderQueue queue;
+	queue.reserve(count);
+	unsigned int addedOrderChanges = 0, sortedChanges = 0;
+	double radix = 0.0;
+	for (int frame = 0; frame < warmupFrames + frames; frame++)
+	{
+		clock::time_point start = clock::now();
+		queue.clear();
+		for (int i = 0; i < count; i++)
+			queue.push(keys[i], (unsigned int)i);
+		if (frame == 0)
+			addedOrderChanges = queue.countStateChanges();
+		queue.sort();
+		if (frame >= warmupFrames)
+			radix += std::chrono::duration<double>(clock::now() - start).count();
+	}
+	radix /= frames;
+	sortedChanges = queue.countStateChanges();
+
+	// the same order from the standard library, stable like the radix sort
+	std::vector<std::pair<uint64_t, unsigned int> > entries(count);
+	double comparison = 0.0;
+	for (int frame = 0; frame < warmupFrames + frames; frame++)
+	{
+		clock::time_point start = clock::now();
+		for (int i = 0; i < count; i++)
+			entries[i] = std::make_pair(keys[i], (unsigned int)i);
+		std::stable_sort(entries.begin(), entries.end(),
+			[](const std::pair<uint64_t, unsigned int>& a, const std::pair<uint64_t, unsigned int>& b) { return a.first < b.first; });
+		if (frame >= warmupFrames)
+			comparison += std::chrono::duration<double>(clock::now() - start).count();
+	}
+	comparison /= frames;
+
+	// same order, opaque draws before transparent ones, front to back within a state and back to front after it
+	bool correct = true;
+	for (size_t i = 0; i < queue.size(); i++)
+	{
+		correct = correct && queue.getItem(i) == entries[i].second;
+		if (i == 0)
+			continue;
+		uint64_t previous = queue.getKey(i - 1), key = queue.getKey(i);
+		float previousDepth = depths[queue.getItem(i - 1)], currentDepth = depths[queue.getItem(i)];
+		RenderPass pass = RenderQueue::getPass(key);
+		correct = correct && RenderQueue::getPass(previous) <= pass;
+		if (RenderQueue::getPass(previous) != pass)
+			continue;
+		if (pass == TRANSPARENT_PASS)
+			correct = correct && previousDepth >= currentDepth;
+		else if (RenderQueue::getState(previous) == RenderQueue::getState(key))
+			correct = correct && previousDepth <= currentDepth;
+	}
+
+	std::cout << "render queue: " << count << " draws, radix sort " << radix * 1000.0 << " ms (" << count / radix / 1e6
+		<< " M/s), std::stable_sort " << comparison * 1000.0 << " ms (" << comparison / radix << "x), state changes "
+		<< addedOrderChanges << " in submission order, " << sortedChanges << " sorted, order " << (correct ? "correct" : "WRONG") << std::endl;
+	return correct ? 0 : 1;
+}
+
+// the patch evaluation flag_shader.tes had before the closed-form basis, binomial coefficients and pow per term
+static int binomialCoefficient(int n, int k)
+{
+	if (k > n)
+		return 0;
+	int r = 1;
+	for (int d = 1; d <= k; d++)
+	{
+		r *= n--;
+		r /= d;
+	}
+	return r;
+}
+
+static float bernsteinPolynomial(int n, int k, float t)
+{
+	return binomialCoefficient(n, k) * std::pow(t, (float)k) * std::pow(1.0f - t, (float)(n - k));
+}
+
+static BezierPatchSample evaluateBezierPatchBinomial(const glm::vec3 controlPoints[16], float u, float v)
+{
+	const int n = 3, m = 3;
+	BezierPatchSample sample;
+	sample.position = glm::vec3(0.0f);
+	sample.tangentU = glm::vec3(0.0f);
+	sample.tangentV = glm::vec3(0.0f);
+	for (int i = 0; i <= n; i++)
+	{
+		for (int j = 0; j <= m; j++)
+		{
+			float bi = bernsteinPolynomial(n, i, u), bj = bernsteinPolynomial(m, j, v);
+			sample.position += controlPoints[j + 4 * i] * bi * bj;
+			if (i != n)
+				sample.tangentU += (controlPoints[(i + 1) * 4 + j] - controlPoints[j + 4 * i]) * bernsteinPolynomial(n - 1, i, u) * bj;
+			if (j != m)
+				sample.tangentV += (controlPoints[i * 4 + j + 1] - controlPoints[j + 4 * i]) * bernsteinPolynomial(m - 1, j, v) * bi;
+		}
+	}
+	sample.tangentU *= (float)n;
+	sample.tangentV *= (float)m;
+	sample.normal = glm::normalize(glm::cross(sample.tangentU, sample.tangentV));
+	return sample;
+}
+
+// difference of a and b relative to the larger of their lengths, at least 1
+static float relativeError(const glm::vec3& a, const glm::vec3& b)
+{
+	return glm::length(a - b) / std::max(1.0f, std::max(glm::length(a), glm::length(b)));
+}
+
+int runBezierCheck()
+{
+	const int patches = 100, gridSteps = 16;
+	const float step = 1e-3f;
+	// float rounding of the two formulations, and the truncation and rounding of central differences at step
+	const float formulationTolerance = 1e-5f, differenceTolerance = 1e-3f, normalTolerance = 1e-3f;
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> coordinate(-5.0f, 5.0f), height(-1.0f, 1.0f);
+	float formulationError = 0.0f, tangentError = 0.0f, normalError = 0.0f;
+	for (int patch = 0; patch < patches; patch++)
+	{
+		// a grid in the xy plane like the flag's, moved out of it by a random height per point
+		glm::vec3 controlPoints[16];
+		glm::vec3 offset(coordinate(random), coordinate(random), coordinate(random));
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 4; j++)
+				controlPoints[j + 4 * i] = offset + glm::vec3((float)i, (float)j, height(random));
+
+		for (int x = 0; x <= gridSteps; x++)
+		{
+			for (int y = 0; y <= gridSteps; y++)
+			{
+				float u = (float)x / gridSteps, v = (float)y / gridSteps;
+				BezierPatchSample sample = evaluateBezierPatch(controlPoints, u, v);
+				BezierPatchSample binomial = evaluateBezierPatchBinomial(controlPoints, u, v);
+				formulationError = std::max(formulationError, relativeError(sample.position, binomial.position));
+				formulationError = std::max(formulationError, relativeError(sample.tangentU, binomial.tangentU));
+				formulationError = std::max(formulationError, relativeError(sample.tangentV, binomial.tangentV));
+				formulationError = std::max(formulationError, relativeError(sample.normal, binomial.normal));
+
+				// the polynomial continues past the edges, so central differences work there too
+				glm::vec3 differenceU = (evaluateBezierPatch(controlPoints, u + step, v).position
+					- evaluateBezierPatch(controlPoints, u - step, v).position) / (2.0f * step);
+				glm::vec3 differenceV = (evaluateBezierPatch(controlPoints, u, v + step).position
+					- evaluateBezierPatch(controlPoints, u, v - step).position) / (2.0f * step);
+				tangentError = std::max(tangentError, relativeError(sample.tangentU, differenceU));
+				tangentError = std::max(tangentError, relativeError(sample.tangentV, differenceV));
+				normalError = std::max(normalError, relativeError(sample.normal, glm::normalize(glm::cross(differenceU, differenceV))));
+			}
+		}
+	}
+
+	bool correct = formulationError <= formulationTolerance && tangentError <= differenceTolerance && normalError <= normalTolerance;
+	std::cout << "bezier: " << patches << " patches on a " << gridSteps + 1 << "x" << gridSteps + 1 << " grid, max error against the "
+		<< "binomial form " << formulationError << ", tangents against central differences " << tangentError << ", normals "
+		<< normalError << ", " << (correct ? "correct" : "WRONG") << std::endl;
+	return correct ? 0 : 1;
+}
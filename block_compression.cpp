@@ -0,0 +1,306 @@
+#include "headers/block_compression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+size_t blockSize(BlockFormat format)
+{
+	return format == BLOCK_BC1 ? 8 : 16;
+}
+
+// principal axis of the block in the first channels of each pixel (power iteration on the covariance),
+// returns the mean and the lowest and highest projection onto the axis
+static void principalExtremes(const unsigned char pixels[64], int channels, float mean[4], float axis[4], float& low, float& high)
+{
+	for (int c = 0; c < 4; c++)
+		mean[c] = axis[c] = 0.0f;
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < channels; c++)
+			mean[c] += pixels[4 * i + c] / 16.0f;
+
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; i++)
+	{
+		float d[4];
+		for (int c = 0; c < channels; c++)
+			d[c] = pixels[4 * i + c] - mean[c];
+		for (int a = 0; a < channels; a++)
+			for (int b = 0; b < channels; b++)
+				covariance[a][b] += d[a] * d[b];
+	}
+
+	for (int c = 0; c < channels; c++)
+		axis[c] = 1.0f;
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = {};
+		for (int a = 0; a < channels; a++)
+			for (int b = 0; b < channels; b++)
+				next[a] += covariance[a][b] * axis[b];
+		float length = 0.0f;
+		for (int c = 0; c < channels; c++)
+			length = std::max(length, std::fabs(next[c]));
+		if (length == 0.0f)
+			break;
+		for (int c = 0; c < channels; c++)
+			axis[c] = next[c] / length;
+	}
+
+	low = high = 0.0f;
+	float lengthSquared = 0.0f;
+	for (int c = 0; c < channels; c++)
+		lengthSquared += axis[c] * axis[c];
+	for (int i = 0; i < 16; i++)
+	{
+		float t = 0.0f;
+		for (int c = 0; c < channels; c++)
+			t += (pixels[4 * i + c] - mean[c]) * axis[c];
+		t /= lengthSquared;
+		low = std::min(low, t);
+		high = std::max(high, t);
+	}
+}
+
+static int clampByte(float value)
+{
+	return std::min(255, std::max(0, (int)(value + 0.5f)));
+}
+
+static unsigned short packRgb565(const int rgb[3])
+{
+	return (unsigned short)(((rgb[0] * 31 + 127) / 255) << 11 | ((rgb[1] * 63 + 127) / 255) << 5 | ((rgb[2] * 31 + 127) / 255));
+}
+
+static void unpackRgb565(unsigned short value, int rgb[3])
+{
+	int r = value >> 11, g = (value >> 5) & 63, b = value & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+static int squaredDistance(const int* a, const unsigned char* b, int channels)
+{
+	int distance = 0;
+	for (int c = 0; c < channels; c++)
+		distance += (a[c] - b[c]) * (a[c] - b[c]);
+	return distance;
+}
+
+// four colour mode block, colour 0 is always the greater one so BC1 never switches to its 1 bit alpha mode
+static void encodeColourBlock(const unsigned char pixels[64], unsigned char* out)
+{
+	float mean[4], axis[4], low, high;
+	principalExtremes(pixels, 3, mean, axis, low, high);
+
+	int endpoints[2][3];
+	for (int c = 0; c < 3; c++)
+	{
+		endpoints[0][c] = clampByte(mean[c] + axis[c] * high);
+		endpoints[1][c] = clampByte(mean[c] + axis[c] * low);
+	}
+	unsigned short colour0 = packRgb565(endpoints[0]);
+	unsigned short colour1 = packRgb565(endpoints[1]);
+	if (colour0 < colour1)
+		std::swap(colour0, colour1);
+
+	unsigned int indices = 0;
+	if (colour0 != colour1)
+	{
+		int palette[4][3];
+		unpackRgb565(colour0, palette[0]);
+		unpackRgb565(colour1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0, bestDistance = squaredDistance(palette[0], &pixels[4 * i], 3);
+			for (int p = 1; p < 4; p++)
+			{
+				int distance = squaredDistance(palette[p], &pixels[4 * i], 3);
+				if (distance < bestDistance)
+				{
+					best = p;
+					bestDistance = distance;
+				}
+			}
+			indices |= (unsigned int)best << (2 * i);
+		}
+	}
+
+	out[0] = colour0 & 0xFF;
+	out[1] = colour0 >> 8;
+	out[2] = colour1 & 0xFF;
+	out[3] = colour1 >> 8;
+	for (int k = 0; k < 4; k++)
+		out[4 + k] = (indices >> (8 * k)) & 0xFF;
+}
+
+// BC4 block of one channel, eight value mode with the block's maximum and minimum as endpoints
+static void encodeChannelBlock(const unsigned char pixels[64], int channel, unsigned char* out)
+{
+	int high = 0, low = 255;
+	for (int i = 0; i < 16; i++)
+	{
+		high = std::max(high, (int)pixels[4 * i + channel]);
+		low = std::min(low, (int)pixels[4 * i + channel]);
+	}
+
+	int palette[8];
+	palette[0] = high;
+	palette[1] = low;
+	for (int p = 1; p < 7; p++)
+		palette[p + 1] = ((7 - p) * high + p * low) / 7;
+
+	unsigned long long indices = 0;
+	for (int i = 0; i < 16 && high != low; i++)
+	{
+		int value = pixels[4 * i + channel];
+		int best = 0;
+		for (int p = 1; p < 8; p++)
+			if (std::abs(palette[p] - value) < std::abs(palette[best] - value))
+				best = p;
+		indices |= (unsigned long long)best << (3 * i);
+	}
+
+	out[0] = (unsigned char)high;
+	out[1] = (unsigned char)low;
+	for (int k = 0; k < 6; k++)
+		out[2 + k] = (indices >> (8 * k)) & 0xFF;
+}
+
+static void writeBits(unsigned char* out, int& position, unsigned int value, int count)
+{
+	for (int i = 0; i < count; i++, position++)
+		if (value & (1u << i))
+			out[position >> 3] |= 1 << (position & 7);
+}
+
+// BC7 mode 6: one RGBA subset, 7 bit endpoints extended by a shared-per-endpoint p-bit, 16 weights
+static void encodeBC7Block(const unsigned char pixels[64], unsigned char* out)
+{
+	static const int WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	float mean[4], axis[4], low, high;
+	principalExtremes(pixels, 4, mean, axis, low, high);
+
+	// each endpoint takes the p-bit that brings its four channels closest to the wanted values
+	int quantized[2][4], pbits[2], endpoints[2][4];
+	for (int e = 0; e < 2; e++)
+	{
+		float t = e == 0 ? low : high;
+		int bestError = -1;
+		for (int p = 0; p < 2; p++)
+		{
+			int error = 0, candidate[4];
+			for (int c = 0; c < 4; c++)
+			{
+				int wanted = clampByte(mean[c] + axis[c] * t);
+				candidate[c] = std::min(127, std::max(0, (wanted - p + 1) >> 1));
+				int value = (candidate[c] << 1) | p;
+				error += (value - wanted) * (value - wanted);
+			}
+			if (bestError < 0 || error < bestError)
+			{
+				bestError = error;
+				pbits[e] = p;
+				std::memcpy(quantized[e], candidate, sizeof(candidate));
+			}
+		}
+		for (int c = 0; c < 4; c++)
+			endpoints[e][c] = (quantized[e][c] << 1) | pbits[e];
+	}
+
+	int indices[16];
+	for (int i = 0; i < 16; i++)
+	{
+		int best = 0, bestDistance = -1;
+		for (int w = 0; w < 16; w++)
+		{
+			int colour[4];
+			for (int c = 0; c < 4; c++)
+				colour[c] = ((64 - WEIGHTS[w]) * endpoints[0][c] + WEIGHTS[w] * endpoints[1][c] + 32) >> 6;
+			int distance = squaredDistance(colour, &pixels[4 * i], 4);
+			if (bestDistance < 0 || distance < bestDistance)
+			{
+				best = w;
+				bestDistance = distance;
+			}
+		}
+		indices[i] = best;
+	}
+
+	// the first index is stored without its top bit, so it has to be below 8
+	if (indices[0] >= 8)
+	{
+		for (int c = 0; c < 4; c++)
+			std::swap(quantized[0][c], quantized[1][c]);
+		std::swap(pbits[0], pbits[1]);
+		for (int i = 0; i < 16; i++)
+			indices[i] = 15 - indices[i];
+	}
+
+	std::memset(out, 0, 16);
+	int position = 0;
+	writeBits(out, position, 1 << 6, 7);
+	for (int c = 0; c < 4; c++)
+	{
+		writeBits(out, position, quantized[0][c], 7);
+		writeBits(out, position, quantized[1][c], 7);
+	}
+	writeBits(out, position, pbits[0], 1);
+	writeBits(out, position, pbits[1], 1);
+	writeBits(out, position, indices[0], 3);
+	for (int i = 1; i < 16; i++)
+		writeBits(out, position, indices[i], 4);
+}
+
+void encodeBlock(BlockFormat format, const unsigned char pixels[64], unsigned char* out)
+{
+	switch (format)
+	{
+	case BLOCK_BC1:
+		encodeColourBlock(pixels, out);
+		break;
+	case BLOCK_BC3:
+		encodeChannelBlock(pixels, 3, out);
+		encodeColourBlock(pixels, out + 8);
+		break;
+	case BLOCK_BC5:
+		encodeChannelBlock(pixels, 0, out);
+		encodeChannelBlock(pixels, 1, out + 8);
+		break;
+	case BLOCK_BC7:
+		encodeBC7Block(pixels, out);
+		break;
+	}
+}
+
+void compressImage(BlockFormat format, const unsigned char* rgba, int width, int height, std::vector<unsigned char>& out)
+{
+	int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	out.resize((size_t)blocksX * blocksY * blockSize(format));
+
+	unsigned char pixels[64];
+	unsigned char* block = out.data();
+	for (int by = 0; by < blocksY; by++)
+	{
+		for (int bx = 0; bx < blocksX; bx++, block += blockSize(format))
+		{
+			for (int y = 0; y < 4; y++)
+			{
+				int sourceY = std::min(by * 4 + y, height - 1);
+				for (int x = 0; x < 4; x++)
+				{
+					int sourceX = std::min(bx * 4 + x, width - 1);
+					std::memcpy(&pixels[4 * (4 * y + x)], &rgba[4 * ((size_t)sourceY * width + sourceX)], 4);
+				}
+			}
+			encodeBlock(format, pixels, block);
+		}
+	}
+}
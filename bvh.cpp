@@ -0,0 +1,327 @@
+#include "headers/bvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+static float surfaceArea(const BoundingBox& box)
+{
+	if (box.isEmpty())
+		return 0.0f;
+	glm::vec3 size = box.max - box.min;
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+static unsigned int binOf(float centroid, float low, float scale)
+{
+	return std::min(Bvh::SAH_BINS - 1, (unsigned int)std::max(0.0f, (centroid - low) * scale));
+}
+
+// false when the box is outside one of the planes left in mask, the planes it is entirely inside are taken out
+static bool insidePlanes(const BoundingBox& box, const Frustum& frustum, unsigned int& mask)
+{
+	glm::vec3 c = box.center();
+	glm::vec3 e = box.extents();
+	for (int p = 0; p < 6; p++)
+	{
+		if (!(mask & (1u << p)))
+			continue;
+		glm::vec3 normal = glm::vec3(frustum.planes[p]);
+		float d = glm::dot(normal, c) + frustum.planes[p].w;
+		float r = glm::dot(glm::abs(normal), e);
+		if (d + r < 0.0f)
+			return false;
+		if (d - r >= 0.0f)
+			mask &= ~(1u << p);
+	}
+	return true;
+}
+
+Bvh::Bvh()
+{
+	BvhNode root = { BoundingBox(), 0, 0 };
+	nodes.push_back(root);
+	parents.push_back(0);
+}
+
+// Nodes are split in the order they were added, so every child lands after its parent. Boxes must not be empty,
+// an empty box is never visible and never hit.
+void Bvh::build(const BoundingBox* boxes, unsigned int count)
+{
+	objects.resize(count);
+	slots.resize(count);
+	leaves.resize(count);
+	leafBoxes.assign(boxes, boxes + count);
+	std::vector<glm::vec3> centroids(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		objects[i] = i;
+		centroids[i] = boxes[i].center();
+	}
+
+	nodes.clear();
+	parents.clear();
+	nodes.reserve(count > 0 ? 2 * (size_t)count - 1 : 1);
+	parents.reserve(nodes.capacity());
+	BvhNode root = { BoundingBox(), 0, count };
+	nodes.push_back(root);
+	parents.push_back(0);
+	if (count == 0)
+		return;
+
+	for (unsigned int node = 0; node < nodes.size(); node++)
+	{
+		fitNode(node);
+		split(node, centroids);
+	}
+
+	for (unsigned int node = 0; node < nodes.size(); node++)
+	{
+		if (!nodes[node].isLeaf())
+			continue;
+		for (unsigned int slot = nodes[node].leftFirst; slot < nodes[node].leftFirst + nodes[node].count; slot++)
+		{
+			slots[objects[slot]] = slot;
+			leaves[objects[slot]] = node;
+		}
+	}
+}
+
+// Picks the cheapest of the SAH_BINS - 1 planes between the bins on every axis, cost being the area of each side
+// times its objects, and splits the node there if that is cheaper than keeping it a leaf.
+void Bvh::split(unsigned int node, std::vector<glm::vec3>& centroids)
+{
+	unsigned int first = nodes[node].leftFirst, count = nodes[node].count;
+	if (count <= MAX_LEAF_OBJECTS)
+		return;
+
+	BoundingBox centroidBounds;
+	for (unsigned int slot = first; slot < first + count; slot++)
+		centroidBounds.add(centroids[slot]);
+
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	unsigned int bestBin = 0;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float low = centroidBounds.min[axis], extent = centroidBounds.max[axis] - low;
+		if (extent <= 0.0f)
+			continue;
+		float scale = SAH_BINS / extent;
+
+		BoundingBox binBounds[SAH_BINS];
+		unsigned int binCounts[SAH_BINS] = { 0 };
+		for (unsigned int slot = first; slot < first + count; slot++)
+		{
+			unsigned int bin = binOf(centroids[slot][axis], low, scale);
+			binCounts[bin]++;
+			binBounds[bin].add(leafBoxes[slot]);
+		}
+
+		// left side of every plane swept forwards, the right side backwards
+		float leftCost[SAH_BINS - 1];
+		BoundingBox side;
+		unsigned int sideCount = 0;
+		for (unsigned int bin = 0; bin < SAH_BINS - 1; bin++)
+		{
+			side.add(binBounds[bin]);
+			sideCount += binCounts[bin];
+			leftCost[bin] = surfaceArea(side) * sideCount;
+		}
+		side = BoundingBox();
+		sideCount = 0;
+		for (unsigned int bin = SAH_BINS - 1; bin > 0; bin--)
+		{
+			side.add(binBounds[bin]);
+			sideCount += binCounts[bin];
+			float cost = leftCost[bin - 1] + surfaceArea(side) * sideCount;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = bin - 1;
+			}
+		}
+	}
+
+	unsigned int middle = first;
+	if (bestAxis < 0)
+	{
+		// every centroid in the same place, halved so the leaves stay small
+		middle = first + count / 2;
+	}
+	else
+	{
+		if (bestCost >= surfaceArea(nodes[node].bounds) * count)
+			return;
+		float low = centroidBounds.min[bestAxis];
+		float scale = SAH_BINS / (centroidBounds.max[bestAxis] - low);
+		unsigned int last = first + count;
+		while (middle < last)
+		{
+			if (binOf(centroids[middle][bestAxis], low, scale) <= bestBin)
+				middle++;
+			else
+				swapSlots(middle, --last, centroids);
+		}
+		if (middle == first || middle == first + count)
+			return;
+	}
+
+	unsigned int left = (unsigned int)nodes.size();
+	BvhNode leftNode = { BoundingBox(), first, middle - first };
+	BvhNode rightNode = { BoundingBox(), middle, first + count - middle };
+	nodes.push_back(leftNode);
+	nodes.push_back(rightNode);
+	parents.push_back(node);
+	parents.push_back(node);
+	nodes[node].leftFirst = left;
+	nodes[node].count = 0;
+}
+
+void Bvh::swapSlots(unsigned int a, unsigned int b, std::vector<glm::vec3>& centroids)
+{
+	std::swap(objects[a], objects[b]);
+	std::swap(leafBoxes[a], leafBoxes[b]);
+	std::swap(centroids[a], centroids[b]);
+}
+
+void Bvh::fitNode(unsigned int node)
+{
+	BvhNode& n = nodes[node];
+	BoundingBox bounds;
+	if (n.isLeaf())
+	{
+		for (unsigned int slot = n.leftFirst; slot < n.leftFirst + n.count; slot++)
+			bounds.add(leafBoxes[slot]);
+	}
+	else
+	{
+		bounds.add(nodes[n.leftFirst].bounds);
+		bounds.add(nodes[n.leftFirst + 1].bounds);
+	}
+	n.bounds = bounds;
+}
+
+void Bvh::refit(const BoundingBox* boxes)
+{
+	if (objects.empty())
+		return;
+	for (size_t slot = 0; slot < objects.size(); slot++)
+		leafBoxes[slot] = boxes[objects[slot]];
+	for (size_t node = nodes.size(); node-- > 0;)
+		fitNode((unsigned int)node);
+}
+
+void Bvh::update(unsigned int object, const BoundingBox& box)
+{
+	leafBoxes[slots[object]] = box;
+	unsigned int node = leaves[object];
+	for (;;)
+	{
+		BoundingBox old = nodes[node].bounds;
+		fitNode(node);
+		// the ancestors only change when this node did
+		if (node == 0 || (old.min == nodes[node].bounds.min && old.max == nodes[node].bounds.max))
+			break;
+		node = parents[node];
+	}
+}
+
+void Bvh::cull(const Frustum& frustum, std::vector<unsigned int>& visible) const
+{
+	if (objects.empty())
+		return;
+	// a node and the planes its parent was not entirely inside of
+	struct Entry
+	{
+		unsigned int node;
+		unsigned int planes;
+	};
+	std::vector<Entry> stack;
+	stack.reserve(64);
+	Entry root = { 0, 0x3f };
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		Entry entry = stack.back();
+		stack.pop_back();
+		const BvhNode& node = nodes[entry.node];
+		if (entry.planes && !insidePlanes(node.bounds, frustum, entry.planes))
+			continue;
+		if (node.isLeaf())
+		{
+			for (unsigned int slot = node.leftFirst; slot < node.leftFirst + node.count; slot++)
+			{
+				unsigned int planes = entry.planes;
+				if (!planes || insidePlanes(leafBoxes[slot], frustum, planes))
+					visible.push_back(objects[slot]);
+			}
+		}
+		else
+		{
+			Entry right = { node.leftFirst + 1, entry.planes };
+			Entry left = { node.leftFirst, entry.planes };
+			stack.push_back(right);
+			stack.push_back(left);
+		}
+	}
+}
+
+int Bvh::intersectRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const
+{
+	if (objects.empty())
+		return -1;
+	glm::vec3 inverseDirection = 1.0f / direction;
+	// a node and where the ray enters it, nodes starting beyond the nearest hit so far are skipped
+	struct Entry
+	{
+		unsigned int node;
+		float enter;
+	};
+	std::vector<Entry> stack;
+	stack.reserve(64);
+	float nearest = maxDistance;
+	int hit = -1;
+	Entry root = { 0, 0.0f };
+	if (nodes[0].bounds.intersectsRay(origin, inverseDirection, nearest, root.enter))
+		stack.push_back(root);
+	while (!stack.empty())
+	{
+		Entry entry = stack.back();
+		stack.pop_back();
+		if (entry.enter > nearest)
+			continue;
+		const BvhNode& node = nodes[entry.node];
+		if (node.isLeaf())
+		{
+			for (unsigned int slot = node.leftFirst; slot < node.leftFirst + node.count; slot++)
+			{
+				float enter;
+				if (leafBoxes[slot].intersectsRay(origin, inverseDirection, nearest, enter) && (enter < nearest || hit < 0))
+				{
+					nearest = enter;
+					hit = (int)objects[slot];
+				}
+			}
+			continue;
+		}
+
+		// the nearer child goes on top of the stack, so it can shorten the ray before the other one is visited
+		Entry left = { node.leftFirst, 0.0f }, right = { node.leftFirst + 1, 0.0f };
+		bool hitLeft = nodes[left.node].bounds.intersectsRay(origin, inverseDirection, nearest, left.enter);
+		bool hitRight = nodes[right.node].bounds.intersectsRay(origin, inverseDirection, nearest, right.enter);
+		if (hitLeft && hitRight)
+		{
+			stack.push_back(left.enter <= right.enter ? right : left);
+			stack.push_back(left.enter <= right.enter ? left : right);
+		}
+		else if (hitLeft)
+			stack.push_back(left);
+		else if (hitRight)
+			stack.push_back(right);
+	}
+	if (hit >= 0)
+		distance = nearest;
+	return hit;
+}
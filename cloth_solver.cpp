@@ -0,0 +1,271 @@
+#include "headers/cloth_solver.h"
+#include "headers/thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+#include <emmintrin.h>
+#endif
+
+// bending springs skip one particle and are softer, so the cloth can fold
+static const float STRUCTURAL_STIFFNESS = 1.0f;
+static const float SHEAR_STIFFNESS = 1.0f;
+static const float BEND_STIFFNESS = 0.3f;
+
+// chunk sizes handed to the thread pool, smaller work runs on the calling thread
+static const int PARTICLES_PER_CHUNK = 4096;
+static const int CONSTRAINTS_PER_CHUNK = 2048;
+
+ClothSolver::ClothSolver(int columns, int rows, float width, float height)
+	: gravity(0.0f, -9.81f, 0.0f), damping(0.99f), iterations(8), columns(columns), rows(rows), pool(NULL)
+{
+	int count = columns * rows;
+	posX.resize(count);
+	posY.resize(count);
+	posZ.resize(count);
+	invMass.assign(count, 1.0f);
+	restX.resize(columns);
+	restY.resize(rows);
+	flutterX.resize(columns);
+	flutterY.resize(rows);
+
+	for (int c = 0; c < columns; c++)
+		restX[c] = width * c / (float)(columns - 1);
+	for (int r = 0; r < rows; r++)
+		restY[r] = height * r / (float)(rows - 1);
+
+	for (int r = 0; r < rows; r++)
+	{
+		for (int c = 0; c < columns; c++)
+		{
+			int i = r * columns + c;
+			posX[i] = restX[c];
+			posY[i] = restY[r];
+			posZ[i] = 0.0f;
+		}
+	}
+	prevX = posX;
+	prevY = posY;
+	prevZ = posZ;
+
+	// structural, shear and bending constraints
+	constraints.reserve(count * 6);
+	for (int r = 0; r < rows; r++)
+	{
+		for (int c = 0; c < columns; c++)
+		{
+			int i = r * columns + c;
+			if (c + 1 < columns)
+				addConstraint(i, i + 1, STRUCTURAL_STIFFNESS);
+			if (r + 1 < rows)
+				addConstraint(i, i + columns, STRUCTURAL_STIFFNESS);
+			if (c + 1 < columns && r + 1 < rows)
+			{
+				addConstraint(i, i + columns + 1, SHEAR_STIFFNESS);
+				addConstraint(i + 1, i + columns, SHEAR_STIFFNESS);
+			}
+			if (c + 2 < columns)
+				addConstraint(i, i + 2, BEND_STIFFNESS);
+			if (r + 2 < rows)
+				addConstraint(i, i + 2 * columns, BEND_STIFFNESS);
+		}
+	}
+	colourConstraints();
+}
+
+void ClothSolver::addConstraint(int a, int b, float stiffness)
+{
+	DistanceConstraint constraint;
+	constraint.a = a;
+	constraint.b = b;
+	constraint.restLength = glm::length(getPosition(b) - getPosition(a));
+	constraint.stiffness = stiffness;
+	constraints.push_back(constraint);
+}
+
+// Greedy colouring, a constraint takes the lowest colour not used yet by another constraint on either particle.
+// A grid particle is in at most 12 constraints, so no more than 23 colours are needed.
+void ClothSolver::colourConstraints()
+{
+	std::vector<unsigned long long> usedColours(getParticleCount(), 0);
+	std::vector<int> colours(constraints.size());
+	int colourCount = 0;
+	for (size_t k = 0; k < constraints.size(); k++)
+	{
+		unsigned long long used = usedColours[constraints[k].a] | usedColours[constraints[k].b];
+		int colour = 0;
+		while (used & (1ULL << colour))
+			colour++;
+		colours[k] = colour;
+		usedColours[constraints[k].a] |= 1ULL << colour;
+		usedColours[constraints[k].b] |= 1ULL << colour;
+		colourCount = std::max(colourCount, colour + 1);
+	}
+
+	// stable counting sort by colour, the order inside a batch stays the order the constraints were created in
+	batchOffsets.assign(colourCount + 1, 0);
+	for (size_t k = 0; k < colours.size(); k++)
+		batchOffsets[colours[k] + 1]++;
+	for (int c = 0; c < colourCount; c++)
+		batchOffsets[c + 1] += batchOffsets[c];
+
+	std::vector<int> next(batchOffsets.begin(), batchOffsets.end() - 1);
+	std::vector<DistanceConstraint> sorted(constraints.size());
+	for (size_t k = 0; k < constraints.size(); k++)
+		sorted[next[colours[k]]++] = constraints[k];
+	constraints.swap(sorted);
+}
+
+void ClothSolver::pinColumn(int column)
+{
+	for (int r = 0; r < rows; r++)
+		invMass[r * columns + column] = 0.0f;
+}
+
+void ClothSolver::step(float dt, float time, const ClothWind& wind)
+{
+	integrate(dt, time, wind);
+	satisfyConstraints();
+}
+
+void ClothSolver::integrate(float dt, float time, const ClothWind& wind)
+{
+	for (int c = 0; c < columns; c++)
+		flutterX[c] = std::sin(restX[c] * wind.freq + time * wind.speed);
+	for (int r = 0; r < rows; r++)
+		flutterY[r] = std::cos(restY[r] * wind.freq + time * wind.speed);
+
+	glm::vec3 acceleration = gravity + wind.direction * wind.strength;
+	float dt2 = dt * dt;
+	float flutter = wind.flutter;
+	std::function<void(int, int)> integrateRows = [&](int begin, int end)
+	{
+		for (int r = begin; r < end; r++)
+			integrateRow(r, dt2, acceleration, flutter * flutterY[r]);
+	};
+
+	if (pool)
+		pool->parallelFor(rows, std::max(1, PARTICLES_PER_CHUNK / columns), integrateRows);
+	else
+		integrateRows(0, rows);
+}
+
+// x' = x + (x - prev) * damping + a * dt^2, pinned particles are multiplied out by their zero inverse mass
+void ClothSolver::integrateRow(int row, float dt2, const glm::vec3& acceleration, float flutter)
+{
+	int begin = row * columns;
+	int c = 0;
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+	__m128 damping4 = _mm_set1_ps(damping);
+	__m128 stepX = _mm_set1_ps(acceleration.x * dt2);
+	__m128 stepY = _mm_set1_ps(acceleration.y * dt2);
+	__m128 stepZ = _mm_set1_ps(acceleration.z * dt2);
+	__m128 flutter4 = _mm_set1_ps(flutter * dt2);
+	for (; c + 4 <= columns; c += 4)
+	{
+		int i = begin + c;
+		__m128 w = _mm_loadu_ps(&invMass[i]);
+		__m128 fz = _mm_add_ps(stepZ, _mm_mul_ps(flutter4, _mm_loadu_ps(&flutterX[c])));
+
+		__m128 x = _mm_loadu_ps(&posX[i]);
+		__m128 vx = _mm_mul_ps(_mm_sub_ps(x, _mm_loadu_ps(&prevX[i])), damping4);
+		_mm_storeu_ps(&prevX[i], x);
+		_mm_storeu_ps(&posX[i], _mm_add_ps(x, _mm_mul_ps(_mm_add_ps(vx, stepX), w)));
+
+		__m128 y = _mm_loadu_ps(&posY[i]);
+		__m128 vy = _mm_mul_ps(_mm_sub_ps(y, _mm_loadu_ps(&prevY[i])), damping4);
+		_mm_storeu_ps(&prevY[i], y);
+		_mm_storeu_ps(&posY[i], _mm_add_ps(y, _mm_mul_ps(_mm_add_ps(vy, stepY), w)));
+
+		__m128 z = _mm_loadu_ps(&posZ[i]);
+		__m128 vz = _mm_mul_ps(_mm_sub_ps(z, _mm_loadu_ps(&prevZ[i])), damping4);
+		_mm_storeu_ps(&prevZ[i], z);
+		_mm_storeu_ps(&posZ[i], _mm_add_ps(z, _mm_mul_ps(_mm_add_ps(vz, fz), w)));
+	}
+#endif
+
+	// scalar tail of the row, same operations in the same order as the SSE path
+	float stepX1 = acceleration.x * dt2, stepY1 = acceleration.y * dt2, stepZ1 = acceleration.z * dt2;
+	float flutter1 = flutter * dt2;
+	for (; c < columns; c++)
+	{
+		int i = begin + c;
+		float w = invMass[i];
+		float fz = stepZ1 + flutter1 * flutterX[c];
+
+		float x = posX[i], y = posY[i], z = posZ[i];
+		float vx = (x - prevX[i]) * damping;
+		float vy = (y - prevY[i]) * damping;
+		float vz = (z - prevZ[i]) * damping;
+		prevX[i] = x;
+		prevY[i] = y;
+		prevZ[i] = z;
+		posX[i] = x + (vx + stepX1) * w;
+		posY[i] = y + (vy + stepY1) * w;
+		posZ[i] = z + (vz + fz) * w;
+	}
+}
+
+void ClothSolver::satisfyConstraints()
+{
+	for (int iteration = 0; iteration < iterations; iteration++)
+	{
+		for (int batch = 0; batch < getBatchCount(); batch++)
+		{
+			const DistanceConstraint* first = &constraints[batchOffsets[batch]];
+			int count = batchOffsets[batch + 1] - batchOffsets[batch];
+			std::function<void(int, int)> relax = [&](int begin, int end)
+			{
+				for (int k = begin; k < end; k++)
+					satisfyConstraint(first[k]);
+			};
+
+			if (pool)
+				pool->parallelFor(count, CONSTRAINTS_PER_CHUNK, relax);
+			else
+				relax(0, count);
+		}
+	}
+}
+
+// moves both ends along the constraint, split by their inverse masses
+void ClothSolver::satisfyConstraint(const DistanceConstraint& constraint)
+{
+	int a = constraint.a, b = constraint.b;
+	float wA = invMass[a], wB = invMass[b];
+	float wSum = wA + wB;
+	if (wSum == 0.0f)
+		return;
+
+	float dx = posX[b] - posX[a];
+	float dy = posY[b] - posY[a];
+	float dz = posZ[b] - posZ[a];
+	float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+	if (length == 0.0f)
+		return;
+
+	float scale = constraint.stiffness * (length - constraint.restLength) / (length * wSum);
+	dx *= scale;
+	dy *= scale;
+	dz *= scale;
+	posX[a] += dx * wA;
+	posY[a] += dy * wA;
+	posZ[a] += dz * wA;
+	posX[b] -= dx * wB;
+	posY[b] -= dy * wB;
+	posZ[b] -= dz * wB;
+}
+
+void ClothSolver::writePositions(float* out) const
+{
+	int count = getParticleCount();
+	for (int i = 0; i < count; i++)
+	{
+		out[3 * i] = posX[i];
+		out[3 * i + 1] = posY[i];
+		out[3 * i + 2] = posZ[i];
+	}
+}
@@ -0,0 +1,109 @@
+#include "headers/cpu_geometry_arena.h"
+
+#include <algorithm>
+#include <cstring>
+
+CpuGeometryArena cpuGeometry;
+
+RangeAllocator::RangeAllocator() : capacity(0)
+{
+}
+
+bool RangeAllocator::allocate(unsigned int size, unsigned int& offset)
+{
+	size_t best = freeRanges.size();
+	for (size_t i = 0; i < freeRanges.size(); i++)
+		if (freeRanges[i].size >= size && (best == freeRanges.size() || freeRanges[i].size < freeRanges[best].size))
+			best = i;
+	if (best == freeRanges.size())
+		return false;
+
+	offset = freeRanges[best].offset;
+	freeRanges[best].offset += size;
+	freeRanges[best].size -= size;
+	if (freeRanges[best].size == 0)
+		freeRanges.erase(freeRanges.begin() + best);
+	return true;
+}
+
+void RangeAllocator::free(unsigned int offset, unsigned int size)
+{
+	if (size == 0)
+		return;
+	// first free range after the freed one
+	size_t next = 0;
+	while (next < freeRanges.size() && freeRanges[next].offset < offset)
+		next++;
+
+	bool mergePrevious = next > 0 && freeRanges[next - 1].offset + freeRanges[next - 1].size == offset;
+	bool mergeNext = next < freeRanges.size() && offset + size == freeRanges[next].offset;
+	if (mergePrevious && mergeNext)
+	{
+		freeRanges[next - 1].size += size + freeRanges[next].size;
+		freeRanges.erase(freeRanges.begin() + next);
+	}
+	else if (mergePrevious)
+		freeRanges[next - 1].size += size;
+	else if (mergeNext)
+	{
+		freeRanges[next].offset = offset;
+		freeRanges[next].size += size;
+	}
+	else
+	{
+		Range range = { offset, size };
+		freeRanges.insert(freeRanges.begin() + next, range);
+	}
+}
+
+void RangeAllocator::grow(unsigned int newCapacity)
+{
+	unsigned int oldCapacity = capacity;
+	capacity = newCapacity;
+	free(oldCapacity, newCapacity - oldCapacity);
+}
+
+unsigned int RangeAllocator::getFreeSize() const
+{
+	unsigned int size = 0;
+	for (size_t i = 0; i < freeRanges.size(); i++)
+		size += freeRanges[i].size;
+	return size;
+}
+
+unsigned int RangeAllocator::getLargestFree() const
+{
+	unsigned int size = 0;
+	for (size_t i = 0; i < freeRanges.size(); i++)
+		size = std::max(size, freeRanges[i].size);
+	return size;
+}
+
+GeometryRange CpuGeometryArena::add(const void* vertexData, unsigned int stride, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount)
+{
+	GeometryRange range;
+	range.vertexCount = vertexCount;
+	range.indexCount = indexCount;
+	while (!vertexRanges.allocate(vertexCount, range.firstVertex))
+	{
+		vertexRanges.grow(std::max(2 * vertexRanges.getCapacity(), vertexRanges.getCapacity() + vertexCount));
+		positions.resize(vertexRanges.getCapacity());
+	}
+	while (!indexRanges.allocate(indexCount, range.firstIndex))
+	{
+		indexRanges.grow(std::max(2 * indexRanges.getCapacity(), indexRanges.getCapacity() + indexCount));
+		indices.resize(indexRanges.getCapacity());
+	}
+
+	const unsigned char* vertex = (const unsigned char*)vertexData;
+	for (unsigned int i = 0; i < vertexCount; i++, vertex += stride)
+		std::memcpy(&positions[range.firstVertex + i], vertex, sizeof(glm::vec3));
+	std::copy(indexData, indexData + indexCount, indices.begin() + range.firstIndex);
+	return range;
+}
+
+void CpuGeometryArena::remove(const GeometryRange& range)
+{
+	vertexRanges.free(range.firstVertex, range.vertexCount);
+	indexRanges.free(range.firstIndex, range.indexCount);
+}
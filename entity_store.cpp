@@ -0,0 +1,218 @@
+#include "headers/entity_store.h"
+
+#include "glm/gtc/constants.hpp"
+
+#include <cmath>
+
+void DrawList::clear()
+{
+	for (size_t i = 0; i < models.size(); i++)
+	{
+		models[i].clear();
+		materials[i].clear();
+	}
+}
+
+void DrawList::add(unsigned int mesh, const glm::mat4& model, const glm::vec4& material)
+{
+	if (mesh >= models.size())
+	{
+		models.resize(mesh + 1);
+		materials.resize(mesh + 1);
+	}
+	models[mesh].push_back(model);
+	materials[mesh].push_back(material);
+}
+
+unsigned int EntityStore::findArchetype(unsigned int components)
+{
+	for (size_t i = 0; i < archetypes.size(); i++)
+		if (archetypes[i].components == components)
+			return (unsigned int)i;
+	Archetype archetype;
+	archetype.components = components;
+	archetype.transformsChanged = false;
+	archetypes.push_back(archetype);
+	return (unsigned int)archetypes.size() - 1;
+}
+
+Entity EntityStore::create(unsigned int components)
+{
+	Location location;
+	location.archetype = findArchetype(components);
+	Archetype& archetype = archetypes[location.archetype];
+	location.row = (unsigned int)archetype.size();
+
+	Entity entity;
+	if (!freeEntities.empty())
+	{
+		entity = freeEntities.back();
+		freeEntities.pop_back();
+		locations[entity] = location;
+	}
+	else
+	{
+		entity = (Entity)locations.size();
+		locations.push_back(location);
+	}
+
+	archetype.entities.push_back(entity);
+	if (components & TRANSFORM_COMPONENT)
+	{
+		Transform transform = { glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f) };
+		archetype.transforms.push_back(transform);
+		archetype.worlds.push_back(glm::mat4(1.0f));
+		archetype.transformsChanged = true;
+	}
+	if (components & MESH_COMPONENT)
+	{
+		MeshRef mesh = { 0 };
+		archetype.meshes.push_back(mesh);
+	}
+	if (components & MATERIAL_COMPONENT)
+	{
+		Material material = { glm::vec4(1.0f) };
+		archetype.materials.push_back(material);
+	}
+	if (components & LIGHT_COMPONENT)
+	{
+		Light light = { glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f) };
+		archetype.lights.push_back(light);
+	}
+	if (components & ANIMATOR_COMPONENT)
+	{
+		Animator animator = { 0.0f, 0.0f, 0.0f, 0.0f };
+		archetype.animators.push_back(animator);
+	}
+	return entity;
+}
+
+// moves the last element into row and drops the last one, the rows of all arrays stay in step
+template <typename T>
+static void removeRow(std::vector<T>& components, unsigned int row)
+{
+	if (components.empty())
+		return;
+	components[row] = components.back();
+	components.pop_back();
+}
+
+void EntityStore::destroy(Entity entity)
+{
+	Location location = locations[entity];
+	Archetype& archetype = archetypes[location.archetype];
+	Entity moved = archetype.entities.back();
+	removeRow(archetype.entities, location.row);
+	removeRow(archetype.transforms, location.row);
+	removeRow(archetype.worlds, location.row);
+	removeRow(archetype.meshes, location.row);
+	removeRow(archetype.materials, location.row);
+	removeRow(archetype.lights, location.row);
+	removeRow(archetype.animators, location.row);
+	if (moved != entity)
+		locations[moved].row = location.row;
+	freeEntities.push_back(entity);
+}
+
+void EntityStore::reserve(unsigned int components, size_t count)
+{
+	Archetype& archetype = archetypes[findArchetype(components)];
+	archetype.entities.reserve(count);
+	if (components & TRANSFORM_COMPONENT)
+	{
+		archetype.transforms.reserve(count);
+		archetype.worlds.reserve(count);
+	}
+	if (components & MESH_COMPONENT)
+		archetype.meshes.reserve(count);
+	if (components & MATERIAL_COMPONENT)
+		archetype.materials.reserve(count);
+	if (components & LIGHT_COMPONENT)
+		archetype.lights.reserve(count);
+	if (components & ANIMATOR_COMPONENT)
+		archetype.animators.reserve(count);
+}
+
+Transform& EntityStore::transform(Entity entity)
+{
+	Archetype& archetype = archetypeOf(entity);
+	archetype.transformsChanged = true;
+	return archetype.transforms[locations[entity].row];
+}
+
+void EntityStore::animate(float deltaTime)
+{
+	const unsigned int required = TRANSFORM_COMPONENT | ANIMATOR_COMPONENT;
+	const float fullTurn = 2.0f * glm::pi<float>();
+	for (size_t a = 0; a < archetypes.size(); a++)
+	{
+		Archetype& archetype = archetypes[a];
+		if ((archetype.components & required) != required)
+			continue;
+		for (size_t i = 0; i < archetype.size(); i++)
+		{
+			Animator& animator = archetype.animators[i];
+			animator.angle = std::fmod(animator.angle + animator.speed * deltaTime, fullTurn);
+			// the rotation by -angle about y needs the half angle, the position follows from it by the double angle formulas
+			float halfCos = std::cos(0.5f * animator.angle), halfSin = std::sin(0.5f * animator.angle);
+			Transform& transform = archetype.transforms[i];
+			transform.position = glm::vec3(animator.radius * (halfCos * halfCos - halfSin * halfSin), animator.height,
+				animator.radius * 2.0f * halfSin * halfCos);
+			transform.rotation = glm::quat(halfCos, 0.0f, -halfSin, 0.0f);
+		}
+		archetype.transformsChanged = true;
+	}
+}
+
+// translation * rotation * scale written column by column, without the matrix products of glm::translate and
+// glm::scale
+void EntityStore::updateTransforms()
+{
+	for (size_t a = 0; a < archetypes.size(); a++)
+	{
+		Archetype& archetype = archetypes[a];
+		if (!(archetype.components & TRANSFORM_COMPONENT) || !archetype.transformsChanged)
+			continue;
+		for (size_t i = 0; i < archetype.size(); i++)
+		{
+			const Transform& transform = archetype.transforms[i];
+			glm::mat3 rotation = glm::mat3_cast(transform.rotation);
+			glm::mat4& world = archetype.worlds[i];
+			world[0] = glm::vec4(rotation[0] * transform.scale.x, 0.0f);
+			world[1] = glm::vec4(rotation[1] * transform.scale.y, 0.0f);
+			world[2] = glm::vec4(rotation[2] * transform.scale.z, 0.0f);
+			world[3] = glm::vec4(transform.position, 1.0f);
+		}
+		archetype.transformsChanged = false;
+	}
+}
+
+void EntityStore::updateLights()
+{
+	const unsigned int required = TRANSFORM_COMPONENT | LIGHT_COMPONENT;
+	for (size_t a = 0; a < archetypes.size(); a++)
+	{
+		Archetype& archetype = archetypes[a];
+		if ((archetype.components & required) != required)
+			continue;
+		for (size_t i = 0; i < archetype.size(); i++)
+		{
+			Light& light = archetype.lights[i];
+			light.worldPosition = archetype.transforms[i].position;
+			light.worldDirection = glm::vec3(archetype.worlds[i] * glm::vec4(glm::normalize(light.direction), 0.0f));
+		}
+	}
+}
+
+void EntityStore::buildDrawList(DrawList& list) const
+{
+	const unsigned int required = TRANSFORM_COMPONENT | MESH_COMPONENT | MATERIAL_COMPONENT;
+	for (size_t a = 0; a < archetypes.size(); a++)
+	{
+		const Archetype& archetype = archetypes[a];
+		if ((archetype.components & required) != required)
+			continue;
+		for (size_t i = 0; i < archetype.size(); i++)
+			list.add(archetype.meshes[i].mesh, archetype.worlds[i], archetype.materials[i].parameters);
+	}
+}
@@ -0,0 +1,136 @@
+#include "headers/flag.h"
+#include "headers/gl_state.h"
+
+#include <algorithm>
+
+FlagTessellation::FlagTessellation() : pixelsPerSegment(8.0f), minLevel(1.0f), maxLevel(32.0f),
+	pixelsPerSegmentLoc(-1), minLevelLoc(-1), maxLevelLoc(-1), viewportHeightLoc(-1)
+{
+}
+
+void FlagTessellation::resolveLocations(const Shader& shader)
+{
+	pixelsPerSegmentLoc = shader.getUniformLocation("tessellation.pixelsPerSegment");
+	minLevelLoc = shader.getUniformLocation("tessellation.minLevel");
+	maxLevelLoc = shader.getUniformLocation("tessellation.maxLevel");
+	viewportHeightLoc = shader.getUniformLocation("viewportHeight");
+
+	int maxTessLevel = 64;
+	glGetIntegerv(GL_MAX_TESS_GEN_LEVEL, &maxTessLevel);
+	if (maxLevel > (float)maxTessLevel)
+		maxLevel = (float)maxTessLevel;
+}
+
+void FlagTessellation::setUniforms(const Shader& shader, float viewportHeight) const
+{
+	shader.setFloat(pixelsPerSegmentLoc, pixelsPerSegment);
+	shader.setFloat(minLevelLoc, minLevel);
+	shader.setFloat(maxLevelLoc, maxLevel);
+	shader.setFloat(viewportHeightLoc, viewportHeight);
+}
+
+const float Flag::STEP = 1.0f / 120.0f;
+
+Flag::Flag(int patchesX, int patchesY, float width, float height)
+	: patchesX(patchesX), patchesY(patchesY), solver(3 * patchesX + 1, 3 * patchesY + 1, width, height),
+	timeAccumulator(0.0f), simulationTime(0.0f), region(0)
+{
+	solver.pinColumn(0);
+	for (int i = 0; i < UPLOAD_REGIONS; i++)
+		fences[i] = 0;
+
+	// 16 control points per patch, j + 4 * i with i along u (columns) and j along v (rows)
+	int columns = solver.getColumnCount();
+	std::vector<unsigned int> indices;
+	indices.reserve(16 * getPatchCount());
+	for (int py = 0; py < patchesY; py++)
+		for (int px = 0; px < patchesX; px++)
+			for (int i = 0; i < 4; i++)
+				for (int j = 0; j < 4; j++)
+					indices.push_back((3 * py + j) * columns + 3 * px + i);
+
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &EBO);
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, UPLOAD_REGIONS * regionSize(), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	glBindVertexArray(0);
+
+	upload();
+}
+
+Flag::~Flag()
+{
+	for (int i = 0; i < UPLOAD_REGIONS; i++)
+		if (fences[i])
+			glDeleteSync(fences[i]);
+	glDeleteBuffers(1, &EBO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteVertexArrays(1, &VAO);
+}
+
+int Flag::update(float deltaTime, const ClothWind& wind)
+{
+	// a long frame (window drag, breakpoint) is not caught up, it would only make the next frame longer
+	timeAccumulator = std::min(timeAccumulator + deltaTime, MAX_STEPS_PER_FRAME * STEP);
+
+	int steps = 0;
+	while (timeAccumulator >= STEP)
+	{
+		solver.step(STEP, simulationTime, wind);
+		timeAccumulator -= STEP;
+		simulationTime += STEP;
+		steps++;
+	}
+
+	if (steps > 0)
+		upload();
+	return steps;
+}
+
+void Flag::upload()
+{
+	region = (region + 1) % UPLOAD_REGIONS;
+	if (fences[region])
+	{
+		// only blocks when the GPU is more than UPLOAD_REGIONS - 1 frames behind
+		while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+		glDeleteSync(fences[region]);
+		fences[region] = 0;
+	}
+
+	// the fence already guarantees the region is idle, so the driver does not have to synchronize the mapping
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	void* target = glMapBufferRange(GL_ARRAY_BUFFER, region * regionSize(), regionSize(),
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (target)
+	{
+		solver.writePositions((float*)target);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	}
+}
+
+void Flag::draw()
+{
+	glState.bindVertexArray(VAO);
+	glPatchParameteri(GL_PATCH_VERTICES, 16);
+	glDrawElementsBaseVertex(GL_PATCHES, 16 * getPatchCount(), GL_UNSIGNED_INT, 0, region * solver.getParticleCount());
+
+	// the region is free again once this draw has finished
+	if (fences[region])
+		glDeleteSync(fences[region]);
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+BoundingBox Flag::getBounds() const
+{
+	BoundingBox box;
+	for (int i = 0; i < solver.getParticleCount(); i++)
+		box.add(solver.getPosition(i));
+	return box;
+}
@@ -0,0 +1,63 @@
+#include "headers/frame_stats.h"
+
+FrameStats frameStats;
+
+FrameStats::FrameStats()
+{
+	reset();
+}
+
+void FrameStats::reset()
+{
+	uniformLookups = 0;
+	driverUniformLookups = 0;
+	glCalls = 0;
+	glCallsSkipped = 0;
+	opaqueGlCalls = 0;
+	indirectDraws = 0;
+	indirectInstances = 0;
+	indirectBuckets = 0;
+	multiDraw = false;
+	stateChanges = 0;
+	stateChangesAvoided = 0;
+	frustumCulling = false;
+	visibleDraws = 0;
+	culledDraws = 0;
+	sceneCulling = false;
+	visibleSceneObjects = 0;
+	culledSceneObjects = 0;
+	sceneNodes = 0;
+	sceneNodesUpdated = 0;
+	cpuFrameTime = 0.0f;
+	clothSteps = 0;
+	clothTime = 0.0f;
+	gpuTimersOn = false;
+	perVertexNormalMatrix = false;
+	opaqueGpuTime = 0.0f;
+	flagGpuTime = 0.0f;
+	texturesStreaming = false;
+	textureUploadTime = 0.0f;
+}
+
+void FrameStats::print(std::ostream& out) const
+{
+	out << "cpu: " << cpuFrameTime << " ms | uniform lookups: " << uniformLookups
+		<< " (driver: " << driverUniformLookups << ") | gl calls: " << glCalls << " (" << glCallsSkipped << " skipped, opaque "
+		<< opaqueGlCalls << ")";
+	if (indirectDraws > 0)
+		out << " | indirect: " << indirectDraws << " draws (" << indirectInstances << " instances) in " << indirectBuckets << " buckets (" << (multiDraw ? "multi draw" : "fallback") << "), "
+			<< stateChanges << " state changes (" << stateChangesAvoided << " avoided by sorting)";
+	if (sceneCulling)
+		out << " | scene culling: " << visibleSceneObjects << " objects visible, " << culledSceneObjects << " culled";
+	if (frustumCulling)
+		out << " | draw culling: " << visibleDraws << " draws visible, " << culledDraws << " culled";
+	if (sceneNodes > 0)
+		out << " | scene graph: " << sceneNodesUpdated << " of " << sceneNodes << " nodes updated";
+	out << " | cloth: " << clothSteps << " steps, " << clothTime << " ms";
+	if (gpuTimersOn)
+		out << " | gpu opaque: " << opaqueGpuTime << " ms, flag: " << flagGpuTime << " ms (normal matrix "
+			<< (perVertexNormalMatrix ? "per vertex" : "from CPU") << ")";
+	if (texturesStreaming)
+		out << " | texture upload: " << textureUploadTime << " ms";
+	out << std::endl;
+}
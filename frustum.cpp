@@ -0,0 +1,194 @@
+#include "headers/frustum.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+// half extent given to empty boxes so every plane keeps them, finite so that a zero plane component stays zero
+static const float UNBOUNDED = 1e30f;
+
+BoundingBox::BoundingBox() : min(FLT_MAX), max(-FLT_MAX)
+{
+}
+
+BoundingBox BoundingBox::fromPositions(const void* data, unsigned int stride, unsigned int count)
+{
+	BoundingBox box;
+	const unsigned char* vertex = (const unsigned char*)data;
+	for (unsigned int i = 0; i < count; i++, vertex += stride)
+	{
+		glm::vec3 position;
+		std::memcpy(&position, vertex, sizeof(glm::vec3));
+		box.add(position);
+	}
+	return box;
+}
+
+void BoundingBox::add(const glm::vec3& point)
+{
+	min = glm::min(min, point);
+	max = glm::max(max, point);
+}
+
+void BoundingBox::add(const BoundingBox& box)
+{
+	min = glm::min(min, box.min);
+	max = glm::max(max, box.max);
+}
+
+BoundingBox BoundingBox::transformed(const glm::mat4& model) const
+{
+	if (isEmpty())
+		return *this;
+	glm::vec3 c = glm::vec3(model * glm::vec4(center(), 1.0f));
+	glm::vec3 e = extents();
+	glm::vec3 worldExtents = glm::abs(glm::vec3(model[0])) * e.x + glm::abs(glm::vec3(model[1])) * e.y + glm::abs(glm::vec3(model[2])) * e.z;
+	BoundingBox box;
+	box.min = c - worldExtents;
+	box.max = c + worldExtents;
+	return box;
+}
+
+bool BoundingBox::intersectsRay(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float& enter) const
+{
+	if (isEmpty())
+		return false;
+	glm::vec3 t0 = (min - origin) * inverseDirection;
+	glm::vec3 t1 = (max - origin) * inverseDirection;
+	glm::vec3 nearT = glm::min(t0, t1), farT = glm::max(t0, t1);
+	enter = std::max(std::max(nearT.x, nearT.y), std::max(nearT.z, 0.0f));
+	float exit = std::min(std::min(farT.x, farT.y), std::min(farT.z, maxDistance));
+	return enter <= exit;
+}
+
+Frustum::Frustum()
+{
+	for (int i = 0; i < 6; i++)
+		planes[i] = glm::vec4(0.0f);
+}
+
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+	// rows of the matrix, glm stores columns
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	// left, right, bottom, top, near, far
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[3] + rows[2];
+	planes[5] = rows[3] - rows[2];
+}
+
+bool Frustum::intersects(const BoundingBox& box) const
+{
+	if (box.isEmpty())
+		return true;
+	glm::vec3 c = box.center();
+	glm::vec3 e = box.extents();
+	for (int i = 0; i < 6; i++)
+	{
+		glm::vec3 normal = glm::vec3(planes[i]);
+		// signed distance of the center and the projection of the extents on the normal, in the same scale
+		if (glm::dot(normal, c) + planes[i].w + glm::dot(glm::abs(normal), e) < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+void BoxCuller::clear()
+{
+	centerX.clear();
+	centerY.clear();
+	centerZ.clear();
+	extentX.clear();
+	extentY.clear();
+	extentZ.clear();
+}
+
+void BoxCuller::reserve(size_t count)
+{
+	centerX.reserve(count);
+	centerY.reserve(count);
+	centerZ.reserve(count);
+	extentX.reserve(count);
+	extentY.reserve(count);
+	extentZ.reserve(count);
+}
+
+void BoxCuller::add(const BoundingBox& box)
+{
+	glm::vec3 c = box.isEmpty() ? glm::vec3(0.0f) : box.center();
+	glm::vec3 e = box.isEmpty() ? glm::vec3(UNBOUNDED) : box.extents();
+	centerX.push_back(c.x);
+	centerY.push_back(c.y);
+	centerZ.push_back(c.z);
+	extentX.push_back(e.x);
+	extentY.push_back(e.y);
+	extentZ.push_back(e.z);
+}
+
+size_t BoxCuller::test(const Frustum& frustum, std::vector<unsigned char>& visible) const
+{
+	size_t count = size();
+	visible.resize(count);
+	size_t first = 0, visibleCount = 0;
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+	// every plane component broadcast to all four lanes once, the normals also as absolute values
+	__m128 normal[6][3], absNormal[6][3], distance[6];
+	for (int p = 0; p < 6; p++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			normal[p][k] = _mm_set1_ps(frustum.planes[p][k]);
+			absNormal[p][k] = _mm_set1_ps(std::fabs(frustum.planes[p][k]));
+		}
+		distance[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+
+	__m128 zero = _mm_setzero_ps();
+	for (; first + 4 <= count; first += 4)
+	{
+		__m128 cx = _mm_loadu_ps(&centerX[first]);
+		__m128 cy = _mm_loadu_ps(&centerY[first]);
+		__m128 cz = _mm_loadu_ps(&centerZ[first]);
+		__m128 ex = _mm_loadu_ps(&extentX[first]);
+		__m128 ey = _mm_loadu_ps(&extentY[first]);
+		__m128 ez = _mm_loadu_ps(&extentZ[first]);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normal[p][0], cx), _mm_mul_ps(normal[p][1], cy)),
+				_mm_add_ps(_mm_mul_ps(normal[p][2], cz), distance[p]));
+			__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absNormal[p][0], ex), _mm_mul_ps(absNormal[p][1], ey)), _mm_mul_ps(absNormal[p][2], ez));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), zero));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (int k = 0; k < 4; k++)
+			visible[first + k] = (unsigned char)((mask >> k) & 1);
+		visibleCount += (size_t)(((mask >> 0) & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1));
+	}
+#endif
+
+	// the boxes left over, or all of them without SSE
+	for (size_t i = first; i < count; i++)
+	{
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; p++)
+		{
+			const glm::vec4& plane = frustum.planes[p];
+			float d = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+			float r = std::fabs(plane.x) * extentX[i] + std::fabs(plane.y) * extentY[i] + std::fabs(plane.z) * extentZ[i];
+			inside = d + r >= 0.0f;
+		}
+		visible[i] = inside ? 1 : 0;
+		visibleCount += inside ? 1 : 0;
+	}
+	return visibleCount;
+}
@@ -0,0 +1,129 @@
+#include "headers/geometry_arena.h"
+#include "headers/frame_stats.h"
+#include "headers/gl_state.h"
+#include "headers/mesh.h"
+
+#include <algorithm>
+
+GeometryArenas geometryArenas;
+
+GeometryArena::GeometryArena(const VertexLayout& layout) : layout(layout), VBO(0), EBO(0)
+{
+	glGenVertexArrays(1, &VAO);
+	growBuffer(VBO, 0, (size_t)INITIAL_VERTICES * layout.stride());
+	growBuffer(EBO, 0, (size_t)INITIAL_INDICES * sizeof(unsigned int));
+	vertices.grow(INITIAL_VERTICES);
+	indices.grow(INITIAL_INDICES);
+}
+
+GeometryArena::~GeometryArena()
+{
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &EBO);
+}
+
+// Replaces the buffer with a larger one holding the old contents and points the VAO at the new buffers. The copy
+// targets are used so the element buffer binding of whatever VAO is bound is not touched.
+void GeometryArena::growBuffer(unsigned int& buffer, size_t oldSize, size_t newSize)
+{
+	unsigned int grown;
+	glGenBuffers(1, &grown);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+	glBufferData(GL_COPY_WRITE_BUFFER, newSize, NULL, GL_STATIC_DRAW);
+	if (buffer)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glDeleteBuffers(1, &buffer);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	buffer = grown;
+
+	if (!VBO || !EBO)
+		return;
+	glState.bindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	setVertexAttributes(layout);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glState.bindVertexArray(0);
+}
+
+GeometryRange GeometryArena::add(const void* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount)
+{
+	GeometryRange range;
+	range.vertexCount = vertexCount;
+	range.indexCount = indexCount;
+	while (!vertices.allocate(vertexCount, range.firstVertex))
+	{
+		unsigned int capacity = std::max(2 * vertices.getCapacity(), vertices.getCapacity() + vertexCount);
+		growBuffer(VBO, (size_t)vertices.getCapacity() * layout.stride(), (size_t)capacity * layout.stride());
+		vertices.grow(capacity);
+	}
+	while (!indices.allocate(indexCount, range.firstIndex))
+	{
+		unsigned int capacity = std::max(2 * indices.getCapacity(), indices.getCapacity() + indexCount);
+		growBuffer(EBO, (size_t)indices.getCapacity() * sizeof(unsigned int), (size_t)capacity * sizeof(unsigned int));
+		indices.grow(capacity);
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t)range.firstVertex * layout.stride(), (size_t)vertexCount * layout.stride(), vertexData);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t)range.firstIndex * sizeof(unsigned int), (size_t)indexCount * sizeof(unsigned int), indexData);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	return range;
+}
+
+GeometryRange GeometryArena::add(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount)
+{
+	std::vector<unsigned char> vertexData;
+	packVertices(vertices, vertexCount, layout, vertexData);
+	return add(vertexData.data(), vertexCount, indexData, indexCount);
+}
+
+void GeometryArena::remove(const GeometryRange& range)
+{
+	vertices.free(range.firstVertex, range.vertexCount);
+	indices.free(range.firstIndex, range.indexCount);
+}
+
+void GeometryArena::draw(const GeometryRange& range, GLenum mode) const
+{
+	glState.bindVertexArray(VAO);
+	glDrawElementsBaseVertex(mode, range.indexCount, GL_UNSIGNED_INT, (void*)((size_t)range.firstIndex * sizeof(unsigned int)), range.firstVertex);
+	frameStats.glCalls++;
+}
+
+void GeometryArena::printStats(std::ostream& out) const
+{
+	out << "geometry arena (stride " << layout.stride() << "): vertices " << vertices.getCapacity() - vertices.getFreeSize() << " of "
+		<< vertices.getCapacity() << " in use, " << vertices.getFreeRangeCount() << " free ranges (largest " << vertices.getLargestFree()
+		<< "), indices " << indices.getCapacity() - indices.getFreeSize() << " of " << indices.getCapacity() << ", "
+		<< indices.getFreeRangeCount() << " free ranges (largest " << indices.getLargestFree() << ")" << std::endl;
+}
+
+GeometryArena& GeometryArenas::get(const VertexLayout& layout)
+{
+	for (size_t i = 0; i < arenas.size(); i++)
+	{
+		const VertexLayout& existing = arenas[i]->getLayout();
+		if (existing.packed == layout.packed && existing.tangents == layout.tangents && existing.bones == layout.bones)
+			return *arenas[i];
+	}
+	arenas.push_back(std::unique_ptr<GeometryArena>(new GeometryArena(layout)));
+	return *arenas.back();
+}
+
+void GeometryArenas::release()
+{
+	arenas.clear();
+}
+
+void GeometryArenas::printStats(std::ostream& out) const
+{
+	for (size_t i = 0; i < arenas.size(); i++)
+		arenas[i]->printStats(out);
+}
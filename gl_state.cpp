@@ -0,0 +1,77 @@
+#include "headers/gl_state.h"
+#include "headers/frame_stats.h"
+
+// no GL object has this name, so the first call after invalidate() always goes through
+static const unsigned int UNKNOWN = 0xFFFFFFFF;
+
+GLState glState;
+
+GLState::GLState()
+{
+	invalidate();
+}
+
+void GLState::useProgram(unsigned int program)
+{
+	if (this->program == program)
+	{
+		frameStats.glCallsSkipped++;
+		return;
+	}
+	glUseProgram(program);
+	this->program = program;
+	frameStats.glCalls++;
+}
+
+void GLState::activeTexture(unsigned int unit)
+{
+	if (activeUnit == unit)
+	{
+		frameStats.glCallsSkipped++;
+		return;
+	}
+	glActiveTexture(GL_TEXTURE0 + unit);
+	activeUnit = unit;
+	frameStats.glCalls++;
+}
+
+void GLState::bindTexture(unsigned int unit, unsigned int target, unsigned int texture)
+{
+	if (unit < TEXTURE_UNITS && textureTargets[unit] == target && textures[unit] == texture)
+	{
+		frameStats.glCallsSkipped++;
+		return;
+	}
+	activeTexture(unit);
+	glBindTexture(target, texture);
+	if (unit < TEXTURE_UNITS)
+	{
+		textureTargets[unit] = target;
+		textures[unit] = texture;
+	}
+	frameStats.glCalls++;
+}
+
+void GLState::bindVertexArray(unsigned int vertexArray)
+{
+	if (this->vertexArray == vertexArray)
+	{
+		frameStats.glCallsSkipped++;
+		return;
+	}
+	glBindVertexArray(vertexArray);
+	this->vertexArray = vertexArray;
+	frameStats.glCalls++;
+}
+
+void GLState::invalidate()
+{
+	program = UNKNOWN;
+	activeUnit = UNKNOWN;
+	vertexArray = UNKNOWN;
+	for (unsigned int i = 0; i < TEXTURE_UNITS; i++)
+	{
+		textureTargets[i] = UNKNOWN;
+		textures[i] = UNKNOWN;
+	}
+}
@@ -0,0 +1,45 @@
+#include "headers/gpu_timer.h"
+
+GpuTimer::GpuTimer() : current(0), lastTimeMs(0.0f)
+{
+	glGenQueries(2, queries);
+	pending[0] = pending[1] = false;
+}
+
+GpuTimer::~GpuTimer()
+{
+	glDeleteQueries(2, queries);
+}
+
+void GpuTimer::begin()
+{
+	// collect the result of the query issued the previous time, if the GPU is done with it
+	if (pending[current])
+	{
+		int available = 0;
+		glGetQueryObjectiv(queries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+		{
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT, &elapsed);
+			lastTimeMs = (float)(elapsed / 1000000.0);
+			pending[current] = false;
+		}
+	}
+
+	// a query still in flight is restarted only once it finished, otherwise this measurement is skipped
+	if (!pending[current])
+		glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+}
+
+void GpuTimer::end()
+{
+	if (pending[current])
+	{
+		current = 1 - current;
+		return;
+	}
+	glEndQuery(GL_TIME_ELAPSED);
+	pending[current] = true;
+	current = 1 - current;
+}
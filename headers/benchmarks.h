@@ -0,0 +1,46 @@
+#pragma once
+
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <glad/glad.h>
+
+#include <string>
+
+// Benchmarks started from the command line, they print their results and exit without rendering.
+
+// --bench-cloth: ClothSolver steps per second at about 1k, 10k and 100k particles on 1, 2, 4 and 8 threads.
+// Also checks that every thread count gives bitwise identical positions, returns 1 if not.
+// Runs before any window or GL context is created.
+int runClothBenchmark();
+
+// --bench-model-load [path]: time to load the model with assimp and write its cache (cold) against loading it
+// from the cache (warm), texture loading excluded. Needs a current GL context for the mesh buffers.
+int runModelLoadBenchmark(const std::string& path);
+
+// --bench-indirect [objects]: CPU time per frame of submitting the objects (10000 by default) through the
+// IndirectRenderer, drawn one command at a time and with one multi draw per bucket. Needs a current GL context,
+// loader resolves the multi draw entry point.
+int runIndirectDrawBenchmark(int objects, GLADloadproc loader);
+
+// --bench-bvh: build, refit, single object update, frustum cull and ray query times of the scene Bvh over 10k, 100k
+// and 1M random boxes, against testing every box. Returns 1 if the answers differ. Runs before any window or GL
+// context is created.
+int runBvhBenchmark();
+
+// --bench-entities [count]: time per frame of animating and computing the model matrices of that many entities
+// (100000 by default) in the EntityStore, the same work with one struct per object, and building their draw list.
+// Runs before any window or GL context is created.
+int runEntityBenchmark(int count);
+
+// --bench-render-queue [count]: time per frame of pushing and radix sorting the keys of that many random draws
+// (100000 by default) in the RenderQueue, against std::stable_sort, and their state changes before and after. Returns
+// 1 if the orders differ or break the pass and depth rules. Runs before any window or GL context is created.
+int runRenderQueueBenchmark(int count);
+
+// --check-bezier: evaluateBezierPatch, the CPU reference of flag_shader.tes, against the binomial formulation the
+// shader had before and against central differences of its positions on a (u, v) grid of random patches. Returns 1
+// on a mismatch. Runs before any window or GL context is created.
+int runBezierCheck();
+
+#endif
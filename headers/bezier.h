@@ -0,0 +1,62 @@
+#pragma once
+
+#ifndef BEZIER_H
+#define BEZIER_H
+
+#include "glm/glm.hpp"
+
+// CPU reference of the bicubic Bezier patch evaluation in shaders/flag_shader.tes, keep both in sync.
+// Control points are stored like the patch vertices: index j + 4 * i, i goes along u and j along v.
+
+// cubic Bernstein basis B0..B3 at t
+inline glm::vec4 bernsteinBasis(float t)
+{
+	float s = 1.0f - t;
+	return glm::vec4(s * s * s, 3.0f * t * s * s, 3.0f * t * t * s, t * t * t);
+}
+
+// derivative of the cubic Bernstein basis at t
+inline glm::vec4 bernsteinDerivative(float t)
+{
+	float s = 1.0f - t;
+	return glm::vec4(-3.0f * s * s, 3.0f * s * s - 6.0f * t * s, 6.0f * t * s - 3.0f * t * t, 3.0f * t * t);
+}
+
+struct BezierPatchSample
+{
+	glm::vec3 position;
+	glm::vec3 tangentU;
+	glm::vec3 tangentV;
+	glm::vec3 normal;
+};
+
+// position, tangents and unit normal of the patch at (u, v)
+inline BezierPatchSample evaluateBezierPatch(const glm::vec3 controlPoints[16], float u, float v)
+{
+	glm::vec4 bu = bernsteinBasis(u);
+	glm::vec4 bv = bernsteinBasis(v);
+	glm::vec4 du = bernsteinDerivative(u);
+	glm::vec4 dv = bernsteinDerivative(v);
+
+	BezierPatchSample sample;
+	sample.position = glm::vec3(0.0f);
+	sample.tangentU = glm::vec3(0.0f);
+	sample.tangentV = glm::vec3(0.0f);
+
+	// each row of four points is a cubic curve in v, the rows are then blended along u
+	for (int i = 0; i < 4; i++)
+	{
+		const glm::vec3* row = controlPoints + 4 * i;
+		glm::vec3 rowPoint = row[0] * bv.x + row[1] * bv.y + row[2] * bv.z + row[3] * bv.w;
+		glm::vec3 rowTangent = row[0] * dv.x + row[1] * dv.y + row[2] * dv.z + row[3] * dv.w;
+
+		sample.position += rowPoint * bu[i];
+		sample.tangentU += rowPoint * du[i];
+		sample.tangentV += rowTangent * bu[i];
+	}
+
+	sample.normal = glm::normalize(glm::cross(sample.tangentU, sample.tangentV));
+	return sample;
+}
+
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <cstddef>
+#include <vector>
+
+// CPU encoders for the BC block formats used by the baked textures, no GPU involved.
+// Every encoder works on 4x4 blocks of RGBA8 pixels, row by row, and the endpoints are the extremes of the block
+// along its principal axis, so the quality is that of a fast offline encoder rather than a best possible one.
+// BC1: RGB, 8 bytes per block. BC3: BC1 colour plus BC4 alpha, 16 bytes.
+// BC5: red and green as two BC4 blocks, 16 bytes, meant for tangent space normal maps (z is rebuilt in the shader).
+// BC7: RGBA, 16 bytes, mode 6 only (one subset, 7 bit endpoints with a p-bit, 4 bit indices).
+enum BlockFormat
+{
+	BLOCK_BC1,
+	BLOCK_BC3,
+	BLOCK_BC5,
+	BLOCK_BC7
+};
+
+size_t blockSize(BlockFormat format);
+
+// encodes one block, pixels are 16 RGBA8 texels
+void encodeBlock(BlockFormat format, const unsigned char pixels[64], unsigned char* out);
+
+// compresses a whole RGBA8 image, the edge texels are repeated to fill partial blocks
+void compressImage(BlockFormat format, const unsigned char* rgba, int width, int height, std::vector<unsigned char>& out);
+
+#endif
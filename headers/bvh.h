@@ -0,0 +1,70 @@
+#pragma once
+
+#ifndef BVH_H
+#define BVH_H
+
+#include "glm/glm.hpp"
+
+#include "frustum.h"
+
+#include <vector>
+
+// 32 bytes, two to a cache line. An inner node's children are nodes leftFirst and leftFirst + 1, a leaf (count > 0)
+// holds the objects from leftFirst to leftFirst + count - 1 of the leaf order.
+struct BvhNode
+{
+	BoundingBox bounds;
+	unsigned int leftFirst;
+	unsigned int count;
+
+	bool isLeaf() const { return count > 0; }
+};
+
+// Bounding volume hierarchy over the world space boxes of the scene's objects, built with the surface area
+// heuristic over binned centroids. The nodes live in one array, every child after its parent, so refitting is a
+// single backward pass. The object boxes are kept in leaf order next to it, the tests at the leaves read them in
+// sequence.
+// Objects that move keep their place in the tree: update() or refit() grow and shrink the boxes along the way, the
+// tree gets slower as they drift apart and should then be built again.
+class Bvh
+{
+public:
+	// leaves stop splitting below this many objects, or when the SAH finds no split cheaper than the leaf
+	static const unsigned int MAX_LEAF_OBJECTS = 4;
+	static const unsigned int SAH_BINS = 16;
+
+	Bvh();
+
+	// builds the tree over count boxes, object i is boxes[i]
+	void build(const BoundingBox* boxes, unsigned int count);
+	// every object moved, boxes holds the new box of each of them in object order
+	void refit(const BoundingBox* boxes);
+	// one object moved, only the nodes from its leaf up to the root are refitted
+	void update(unsigned int object, const BoundingBox& box);
+
+	// appends the objects whose box intersects the frustum, nodes entirely inside a plane skip it below them
+	void cull(const Frustum& frustum, std::vector<unsigned int>& visible) const;
+	// the object with the nearest box the ray enters within maxDistance, -1 when none; distance is along direction,
+	// which does not have to be normalized
+	int intersectRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const;
+
+	unsigned int getObjectCount() const { return (unsigned int)objects.size(); }
+	size_t getNodeCount() const { return nodes.size(); }
+	const BoundingBox& getBounds() const { return nodes[0].bounds; }
+
+private:
+	std::vector<BvhNode> nodes;
+	// object of every leaf slot, the slot of every object and the boxes in leaf order
+	std::vector<unsigned int> objects;
+	std::vector<unsigned int> slots;
+	std::vector<BoundingBox> leafBoxes;
+	// parent of every node and leaf of every object, only read by update()
+	std::vector<unsigned int> parents;
+	std::vector<unsigned int> leaves;
+
+	void split(unsigned int node, std::vector<glm::vec3>& centroids);
+	void fitNode(unsigned int node);
+	void swapSlots(unsigned int a, unsigned int b, std::vector<glm::vec3>& centroids);
+};
+
+#endif
@@ -21,9 +21,13 @@ const float SPEED = 2.5f;
 const float SENSITIVITY = 0.1f;
 const float ZOOM = 45.0f;
 const float FPS_Y = 0.5f;
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
 
 
-// An abstract camera class that processes input and calculates the corresponding Euler Angles, Vectors and Matrices for use in OpenGL
+// An abstract camera class that processes input and calculates the corresponding Euler Angles, Vectors and Matrices for use in OpenGL.
+// The matrices are cached and only rebuilt after one of the Process*/UpdateTarget methods changed the camera,
+// so modify the camera through them rather than through the public attributes.
 class Camera
 {
 public:
@@ -49,6 +53,7 @@ public:
         Yaw = yaw;
         Pitch = pitch;
         updateCameraVectors();
+        markDirty(true);
     }
 
     // constructor with scalar values
@@ -59,6 +64,7 @@ public:
         Yaw = yaw;
         Pitch = pitch;
         updateCameraVectors();
+        markDirty(true);
     }
 
     Camera(float posX, float posY, float posZ, float targX, float targY, float targZ): MovementSpeed(0), MouseSensitivity(0), Zoom(ZOOM), Yaw(YAW), Pitch(PITCH), WorldUp(glm::vec3(0.0f, 1.0f, 0.0f))
@@ -67,12 +73,45 @@ public:
         Front = glm::normalize(glm::vec3(targX, targY, targZ) - Position);
         Right = glm::normalize(glm::cross(Front, WorldUp));
         Up = glm::normalize(glm::cross(Right, Front));
+        markDirty(true);
     }
 
     // returns the view matrix calculated using Euler Angles and the LookAt Matrix
-    glm::mat4 GetViewMatrix()
+    const glm::mat4& GetViewMatrix()
     {
-        return glm::lookAt(Position, Position + Front, Up);
+        if (viewDirty)
+        {
+            viewMatrix = glm::lookAt(Position, Position + Front, Up);
+            viewDirty = false;
+            viewProjectionDirty = true;
+        }
+        return viewMatrix;
+    }
+
+    // returns the perspective projection for the given aspect ratio, rebuilt only when the zoom or the aspect ratio changed
+    const glm::mat4& GetProjectionMatrix(float aspectRatio)
+    {
+        if (projectionDirty || aspectRatio != projectionAspectRatio)
+        {
+            projectionMatrix = glm::perspective(glm::radians(Zoom), aspectRatio, NEAR_PLANE, FAR_PLANE);
+            projectionAspectRatio = aspectRatio;
+            projectionDirty = false;
+            viewProjectionDirty = true;
+        }
+        return projectionMatrix;
+    }
+
+    // returns projection * view
+    const glm::mat4& GetViewProjectionMatrix(float aspectRatio)
+    {
+        GetViewMatrix();
+        GetProjectionMatrix(aspectRatio);
+        if (viewProjectionDirty)
+        {
+            viewProjectionMatrix = projectionMatrix * viewMatrix;
+            viewProjectionDirty = false;
+        }
+        return viewProjectionMatrix;
     }
 
     // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
@@ -87,6 +126,7 @@ public:
             Position -= Right * velocity;
         if (direction == RIGHT)
             Position += Right * velocity;
+        markDirty(false);
 
         //Position.y = FPS_Y;
     }
@@ -111,6 +151,7 @@ public:
 
         // update Front, Right and Up Vectors using the updated Euler angles
         updateCameraVectors();
+        markDirty(false);
     }
 
     // processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
@@ -121,6 +162,7 @@ public:
             Zoom = 1.0f;
         if (Zoom > 45.0f)
             Zoom = 45.0f;
+        projectionDirty = true;
     }
 
     void UpdateTarget(glm::vec3 target)
@@ -128,9 +170,30 @@ public:
         Front = glm::normalize(target - Position);
         Right = glm::normalize(glm::cross(Front, WorldUp));
         Up = glm::normalize(glm::cross(Right, Front));
+        markDirty(false);
     }
 
 private:
+    // cached matrices
+    glm::mat4 viewMatrix;
+    glm::mat4 projectionMatrix;
+    glm::mat4 viewProjectionMatrix;
+    float projectionAspectRatio;
+    bool viewDirty;
+    bool projectionDirty;
+    bool viewProjectionDirty;
+
+    void markDirty(bool projection)
+    {
+        viewDirty = true;
+        viewProjectionDirty = true;
+        if (projection)
+        {
+            projectionDirty = true;
+            projectionAspectRatio = 0.0f;
+        }
+    }
+
     // calculates the front vector from the Camera's (updated) Euler Angles
     void updateCameraVectors()
     {
@@ -0,0 +1,60 @@
+#pragma once
+#ifndef CAMERA_SYSTEM_H
+#define CAMERA_SYSTEM_H
+
+#include "glm/glm.hpp"
+
+#include "camera.h"
+
+enum CameraType
+{
+    STATIC,
+    TRACKING,
+    FREE
+};
+
+// Owns the scene cameras, tracks which one is active and the aspect ratio of the framebuffer.
+// Matrices come from the per camera caches, so asking for them several times a frame is cheap.
+class CameraSystem
+{
+public:
+    CameraSystem(Camera freeCamera, Camera staticCamera, Camera trackingCamera, int width, int height) : activeType(FREE)
+    {
+        cameras[FREE] = freeCamera;
+        cameras[STATIC] = staticCamera;
+        cameras[TRACKING] = trackingCamera;
+        SetFramebufferSize(width, height);
+    }
+
+    Camera& Get(CameraType type) { return cameras[type]; }
+    Camera& GetActive() { return cameras[activeType]; }
+    CameraType GetActiveType() const { return activeType; }
+    void SetActive(CameraType type) { activeType = type; }
+
+    // called from the framebuffer size callback, a minimized window (0x0) keeps the previous aspect ratio
+    void SetFramebufferSize(int width, int height)
+    {
+        if (width <= 0 || height <= 0)
+            return;
+        framebufferWidth = width;
+        framebufferHeight = height;
+        aspectRatio = (float)width / (float)height;
+    }
+
+    float GetAspectRatio() const { return aspectRatio; }
+    int GetFramebufferWidth() const { return framebufferWidth; }
+    int GetFramebufferHeight() const { return framebufferHeight; }
+
+    const glm::mat4& GetViewMatrix() { return GetActive().GetViewMatrix(); }
+    const glm::mat4& GetProjectionMatrix() { return GetActive().GetProjectionMatrix(aspectRatio); }
+    const glm::mat4& GetViewProjectionMatrix() { return GetActive().GetViewProjectionMatrix(aspectRatio); }
+    glm::vec3 GetPosition() { return GetActive().Position; }
+
+private:
+    Camera cameras[3];
+    CameraType activeType;
+    int framebufferWidth;
+    int framebufferHeight;
+    float aspectRatio;
+};
+#endif
@@ -0,0 +1,93 @@
+#pragma once
+
+#ifndef CLOTH_SOLVER_H
+#define CLOTH_SOLVER_H
+
+#include "glm/glm.hpp"
+
+#include <vector>
+
+class ThreadPool;
+
+// Wind acting on the cloth: a steady push along direction plus a flutter across the cloth that travels with time.
+// The flutter is the CPU version of the old applyWind from flag_shader.tcs.
+struct ClothWind
+{
+	glm::vec3 direction;
+	float strength;
+	float flutter;
+	float freq;
+	float speed;
+};
+
+// Verlet integrated particle grid held together by distance constraints (Jakobsen style relaxation).
+// Particles are stored as structure of arrays, row by row, so the integration runs four particles at a time with SSE.
+// Particle (column, row) rests at (column * width / (columns - 1), row * height / (rows - 1), 0).
+// The constraints are graph coloured into batches in which no two constraints share a particle. The batches are
+// relaxed one after another and the constraints of a batch in any order, so with a thread pool the result is
+// bitwise identical to the single threaded one, whatever the number of threads.
+class ClothSolver
+{
+public:
+	ClothSolver(int columns, int rows, float width, float height);
+
+	// pinned particles keep their position, used for the pole of the flag
+	void pinColumn(int column);
+
+	// advances the simulation by one fixed time step
+	void step(float dt, float time, const ClothWind& wind);
+
+	// rows and constraint batches are split over the pool, NULL runs everything on the calling thread
+	void setThreadPool(ThreadPool* threadPool) { pool = threadPool; }
+
+	int getColumnCount() const { return columns; }
+	int getRowCount() const { return rows; }
+	int getParticleCount() const { return columns * rows; }
+	int getConstraintCount() const { return (int)constraints.size(); }
+	int getBatchCount() const { return (int)batchOffsets.size() - 1; }
+	glm::vec3 getPosition(int index) const { return glm::vec3(posX[index], posY[index], posZ[index]); }
+
+	// interleaved xyz positions, 3 * getParticleCount() floats
+	void writePositions(float* out) const;
+
+	glm::vec3 gravity;
+	float damping;
+	int iterations;
+
+private:
+	struct DistanceConstraint
+	{
+		int a;
+		int b;
+		float restLength;
+		float stiffness;
+	};
+
+	int columns;
+	int rows;
+
+	// current and previous positions, inverse mass is 1 for free and 0 for pinned particles
+	std::vector<float> posX, posY, posZ;
+	std::vector<float> prevX, prevY, prevZ;
+	std::vector<float> invMass;
+
+	// rest coordinates of the columns and rows, the flutter phase depends on them
+	std::vector<float> restX, restY;
+	// flutter factors of the current step, one sin per column and one cos per row instead of one per particle
+	std::vector<float> flutterX, flutterY;
+
+	// constraints sorted by batch, batch k is [batchOffsets[k], batchOffsets[k + 1])
+	std::vector<DistanceConstraint> constraints;
+	std::vector<int> batchOffsets;
+
+	ThreadPool* pool;
+
+	void addConstraint(int a, int b, float stiffness);
+	void colourConstraints();
+	void integrate(float dt, float time, const ClothWind& wind);
+	void integrateRow(int row, float dt2, const glm::vec3& acceleration, float flutter);
+	void satisfyConstraints();
+	void satisfyConstraint(const DistanceConstraint& constraint);
+};
+
+#endif
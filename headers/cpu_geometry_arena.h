@@ -0,0 +1,89 @@
+#pragma once
+
+#ifndef CPU_GEOMETRY_ARENA_H
+#define CPU_GEOMETRY_ARENA_H
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <vector>
+
+// what a model keeps of its geometry on the CPU once the meshes are uploaded
+enum GeometryRetention
+{
+	// the full Vertex and index vectors of every mesh, as before
+	GEOMETRY_KEEP,
+	// nothing, the GPU buffers are the only copy
+	GEOMETRY_DROP,
+	// positions and indices only, in the shared cpuGeometry arena
+	GEOMETRY_ARENA
+};
+
+// a mesh's part of the arena, its indices are relative to firstVertex
+struct GeometryRange
+{
+	unsigned int firstVertex;
+	unsigned int vertexCount;
+	unsigned int firstIndex;
+	unsigned int indexCount;
+};
+
+// Free list over [0, capacity) in units of vertices or indices. Ranges are handed out best fit, and a freed range is
+// merged with the free neighbours on both sides, so the list never holds two adjacent ranges: there are at most as
+// many holes as live allocations between them, however many models are loaded and unloaded.
+class RangeAllocator
+{
+public:
+	RangeAllocator();
+
+	// false when no free range is large enough
+	bool allocate(unsigned int size, unsigned int& offset);
+	void free(unsigned int offset, unsigned int size);
+	// adds [capacity, newCapacity) to the free ranges
+	void grow(unsigned int newCapacity);
+
+	unsigned int getCapacity() const { return capacity; }
+	unsigned int getFreeSize() const;
+	unsigned int getLargestFree() const;
+	size_t getFreeRangeCount() const { return freeRanges.size(); }
+
+private:
+	struct Range
+	{
+		unsigned int offset;
+		unsigned int size;
+	};
+
+	// sorted by offset
+	std::vector<Range> freeRanges;
+	unsigned int capacity;
+};
+
+// Positions and triangle indices for CPU queries such as picking and physics, for all models in two flat arrays:
+// 12 bytes per vertex instead of the 88 byte Vertex, and no allocation per mesh. Ranges come from a RangeAllocator
+// like the GPU arenas, so a model that is unloaded leaves holes the next models fill; when a range does not fit, the
+// arrays grow to twice their size.
+class CpuGeometryArena
+{
+public:
+	// copies the first three floats of every vertex, stride bytes apart (the position in Vertex and in every VertexLayout)
+	GeometryRange add(const void* vertexData, unsigned int stride, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount);
+	// frees the range, its positions and indices must not be used afterwards
+	void remove(const GeometryRange& range);
+
+	const glm::vec3* getPositions(const GeometryRange& range) const { return positions.data() + range.firstVertex; }
+	const unsigned int* getIndices(const GeometryRange& range) const { return indices.data() + range.firstIndex; }
+
+	// bytes allocated for the positions and indices
+	size_t memoryUsage() const { return positions.capacity() * sizeof(glm::vec3) + indices.capacity() * sizeof(unsigned int); }
+
+private:
+	std::vector<glm::vec3> positions;
+	std::vector<unsigned int> indices;
+	RangeAllocator vertexRanges;
+	RangeAllocator indexRanges;
+};
+
+extern CpuGeometryArena cpuGeometry;
+
+#endif
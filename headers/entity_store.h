@@ -0,0 +1,140 @@
+#pragma once
+
+#ifndef ENTITY_STORE_H
+#define ENTITY_STORE_H
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include <vector>
+
+// Components of the scene's entities, plain data. The systems of the EntityStore read and write them.
+
+struct Transform
+{
+	glm::vec3 position;
+	glm::quat rotation;
+	glm::vec3 scale;
+};
+
+// index into the caller's table of meshes, and of the batches of a DrawList
+struct MeshRef
+{
+	unsigned int mesh;
+};
+
+// the per instance material of the IndirectRenderer: diffuse tint in xyz, shininess scale in w
+struct Material
+{
+	glm::vec4 parameters;
+};
+
+// spotlight carried by the entity, direction is in the entity's space; the light system writes the world values
+struct Light
+{
+	glm::vec3 direction;
+	glm::vec3 worldPosition;
+	glm::vec3 worldDirection;
+};
+
+// circles the y axis at height, turned to face along the circle, angle advancing by speed radians per second
+struct Animator
+{
+	float radius;
+	float height;
+	float speed;
+	float angle;
+};
+
+enum ComponentFlags
+{
+	TRANSFORM_COMPONENT = 1,
+	MESH_COMPONENT = 2,
+	MATERIAL_COMPONENT = 4,
+	LIGHT_COMPONENT = 8,
+	ANIMATOR_COMPONENT = 16
+};
+
+typedef unsigned int Entity;
+
+// The entities with one set of components. Every component has its own dense array, the rows of all arrays are in
+// the same entity order and only the arrays of the archetype's components are used. worlds holds the model matrix
+// of every Transform.
+struct Archetype
+{
+	unsigned int components;
+	std::vector<Entity> entities;
+	std::vector<Transform> transforms;
+	std::vector<glm::mat4> worlds;
+	std::vector<MeshRef> meshes;
+	std::vector<Material> materials;
+	std::vector<Light> lights;
+	std::vector<Animator> animators;
+	// a transform changed since the last updateTransforms()
+	bool transformsChanged;
+
+	size_t size() const { return entities.size(); }
+};
+
+// instances of every mesh, ready for IndirectRenderer::addInstances
+struct DrawList
+{
+	std::vector<std::vector<glm::mat4> > models;
+	std::vector<std::vector<glm::vec4> > materials;
+
+	// empties the batches, their memory is kept for the next frame
+	void clear();
+	void add(unsigned int mesh, const glm::mat4& model, const glm::vec4& material);
+	unsigned int getInstanceCount(unsigned int mesh) const { return mesh < models.size() ? (unsigned int)models[mesh].size() : 0; }
+};
+
+// Entities stored by archetype, so the systems below are loops over dense arrays without lookups. An entity stays
+// in the archetype it was created with; destroying one moves the last row of its archetype into its place.
+class EntityStore
+{
+public:
+	// a new entity with default components: identity transform, mesh 0, white material
+	Entity create(unsigned int components);
+	void destroy(Entity entity);
+	void reserve(unsigned int components, size_t count);
+
+	bool has(Entity entity, unsigned int component) const { return (archetypes[locations[entity].archetype].components & component) != 0; }
+	// the entity's components, the reference is valid until the next create() or destroy(). transform() marks the
+	// archetype for the next updateTransforms().
+	Transform& transform(Entity entity);
+	MeshRef& mesh(Entity entity) { return archetypeOf(entity).meshes[locations[entity].row]; }
+	Material& material(Entity entity) { return archetypeOf(entity).materials[locations[entity].row]; }
+	Light& light(Entity entity) { return archetypeOf(entity).lights[locations[entity].row]; }
+	Animator& animator(Entity entity) { return archetypeOf(entity).animators[locations[entity].row]; }
+	const glm::mat4& world(Entity entity) const { return archetypes[locations[entity].archetype].worlds[locations[entity].row]; }
+
+	// systems
+	// moves the entities with an Animator along their circle
+	void animate(float deltaTime);
+	// model matrices of the archetypes whose transforms changed
+	void updateTransforms();
+	// world position and direction of every Light, after updateTransforms()
+	void updateLights();
+	// every entity with a mesh, a material and a transform, added to its mesh's batch
+	void buildDrawList(DrawList& list) const;
+
+	size_t getArchetypeCount() const { return archetypes.size(); }
+	const Archetype& getArchetype(size_t index) const { return archetypes[index]; }
+	size_t getEntityCount() const { return locations.size() - freeEntities.size(); }
+
+private:
+	struct Location
+	{
+		unsigned int archetype;
+		unsigned int row;
+	};
+
+	std::vector<Archetype> archetypes;
+	std::vector<Location> locations;
+	std::vector<Entity> freeEntities;
+
+	Archetype& archetypeOf(Entity entity) { return archetypes[locations[entity].archetype]; }
+	unsigned int findArchetype(unsigned int components);
+};
+
+#endif
@@ -3,11 +3,76 @@
 #ifndef GEOMETRY_FLAG_H
 #define GEOMETRY_FLAG_H
 
+#include <glad/glad.h>
+
+#include "shader.h"
+#include "cloth_solver.h"
+#include "frustum.h"
+
+// Tessellation levels of the flag patches follow their size on screen, see shaders/flag_shader.tcs.
+// An edge is split into segments of about pixelsPerSegment pixels, clamped to [minLevel, maxLevel].
+struct FlagTessellation
+{
+	float pixelsPerSegment;
+	float minLevel;
+	float maxLevel;
+
+	FlagTessellation();
+
+	// resolves the uniform locations and limits maxLevel to what the driver supports, call once after linking
+	void resolveLocations(const Shader& shader);
+	void setUniforms(const Shader& shader, float viewportHeight) const;
+
+private:
+	int pixelsPerSegmentLoc;
+	int minLevelLoc;
+	int maxLevelLoc;
+	int viewportHeightLoc;
+};
+
+// Cloth flag made of patchesX x patchesY bicubic Bezier patches. The control points are the particles of a ClothSolver
+// grid, neighbouring patches share their border rows, so the surface stays closed while it moves. Column 0 is the pole.
+// Positions are streamed after every simulated frame into a ring of UPLOAD_REGIONS regions of one buffer. Each region
+// is guarded by a fence, so the CPU never writes into a region the GPU may still read. GL 4.0 has no persistent mapping
+// (glBufferStorage is 4.4), the regions are mapped unsynchronized instead.
 class Flag
 {
 public:
-	Flag();
-	~Flag() {}
+	static const int UPLOAD_REGIONS = 3;
+	// fixed solver step, the frame time is consumed in steps of this size
+	static const float STEP;
+	static const int MAX_STEPS_PER_FRAME = 8;
+
+	Flag(int patchesX, int patchesY, float width, float height);
+	~Flag();
+
+	// runs the solver steps due for this frame and uploads the positions if they changed, returns the number of steps
+	int update(float deltaTime, const ClothWind& wind);
+	void draw();
+
+	// box around the control points in model space, the Bezier surface stays inside their convex hull
+	BoundingBox getBounds() const;
+
+	const ClothSolver& getSolver() const { return solver; }
+	// large flags can spread their solver over a pool, see ClothSolver::setThreadPool
+	void setThreadPool(ThreadPool* pool) { solver.setThreadPool(pool); }
+	int getPatchCount() const { return patchesX * patchesY; }
+
+private:
+	int patchesX;
+	int patchesY;
+	ClothSolver solver;
+	float timeAccumulator;
+	float simulationTime;
+
+	unsigned int VAO, VBO, EBO;
+	GLsync fences[UPLOAD_REGIONS];
+	int region;
+
+	GLsizeiptr regionSize() const { return 3 * solver.getParticleCount() * sizeof(float); }
+	void upload();
 
+	Flag(const Flag&);
+	Flag& operator=(const Flag&);
 };
-#endif
\ No newline at end of file
+#endif
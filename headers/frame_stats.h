@@ -0,0 +1,64 @@
+#pragma once
+
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <iostream>
+
+// Counters gathered during a single frame. Reset at the start of every frame in the render loop.
+struct FrameStats
+{
+	// name -> location lookups resolved through the Shader uniform tables
+	unsigned int uniformLookups;
+	// glGetUniformLocation round-trips to the driver
+	unsigned int driverUniformLookups;
+	// binds and program switches through GLState plus the draw and sampler calls of the meshes: issued to GL, and
+	// skipped because they set what was already bound. opaqueGlCalls is the part issued by the opaque objects' flush.
+	unsigned int glCalls;
+	unsigned int glCallsSkipped;
+	unsigned int opaqueGlCalls;
+	// draws submitted through the IndirectRenderer with their instances, the state buckets they were in and whether
+	// multi draw was used
+	unsigned int indirectDraws;
+	unsigned int indirectInstances;
+	unsigned int indirectBuckets;
+	bool multiDraw;
+	// program, texture set and vertex array switches between the sorted commands, and how many more drawing them in
+	// the order they were added would have made
+	unsigned int stateChanges;
+	unsigned int stateChangesAvoided;
+	// draws and instances of the IndirectRenderer inside the camera frustum by its per draw test and outside it,
+	// which were not submitted
+	bool frustumCulling;
+	unsigned int visibleDraws;
+	unsigned int culledDraws;
+	// scene objects the BVH found inside the camera frustum and outside it, the backpack counts once for all its meshes
+	bool sceneCulling;
+	unsigned int visibleSceneObjects;
+	unsigned int culledSceneObjects;
+	// scene graph nodes and the ones whose world matrix was recomputed
+	unsigned int sceneNodes;
+	unsigned int sceneNodesUpdated;
+	// CPU time from the start of the frame until the buffer swap, in milliseconds
+	float cpuFrameTime;
+	// cloth solver steps run for the flag this frame and the time they took with the upload, in milliseconds
+	int clothSteps;
+	float clothTime;
+	// GPU time of the opaque objects and flag draws from the timer queries, in milliseconds (results lag a frame or two)
+	bool gpuTimersOn;
+	bool perVertexNormalMatrix;
+	float opaqueGpuTime;
+	float flagGpuTime;
+	// texture rows streamed in this frame while the scene's textures are still arriving, in milliseconds
+	bool texturesStreaming;
+	float textureUploadTime;
+
+	FrameStats();
+
+	void reset();
+	void print(std::ostream& out) const;
+};
+
+extern FrameStats frameStats;
+
+#endif
@@ -0,0 +1,65 @@
+#pragma once
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <vector>
+
+// axis aligned box, empty (min above max) until a point is added
+struct BoundingBox
+{
+	glm::vec3 min;
+	glm::vec3 max;
+
+	BoundingBox();
+
+	// box around count positions stride bytes apart, the first three floats of every vertex
+	static BoundingBox fromPositions(const void* data, unsigned int stride, unsigned int count);
+
+	void add(const glm::vec3& point);
+	void add(const BoundingBox& box);
+	bool isEmpty() const { return min.x > max.x; }
+	glm::vec3 center() const { return 0.5f * (min + max); }
+	glm::vec3 extents() const { return 0.5f * (max - min); }
+	// the box around the transformed box, from the absolute values of the matrix (Arvo)
+	BoundingBox transformed(const glm::mat4& model) const;
+	// slab test of the ray origin + t * direction for t up to maxDistance, given 1 / direction; enter is where the ray
+	// enters the box, 0 when it starts inside
+	bool intersectsRay(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float& enter) const;
+};
+
+// The six planes of a view projection matrix (Gribb and Hartmann), pointing inwards. Not normalized, the box test
+// only compares signs.
+struct Frustum
+{
+	glm::vec4 planes[6];
+
+	Frustum();
+	explicit Frustum(const glm::mat4& viewProjection);
+
+	// false only when the box is entirely outside one plane, boxes across a corner of the frustum are kept
+	bool intersects(const BoundingBox& box) const;
+};
+
+// World space boxes of the objects of a frame, kept as centers and half extents in separate arrays so that SSE tests
+// four of them against a plane at once. Empty boxes are always visible.
+class BoxCuller
+{
+public:
+	void clear();
+	void reserve(size_t count);
+	void add(const BoundingBox& box);
+	size_t size() const { return centerX.size(); }
+
+	// visible[i] is 1 for every box intersecting the frustum and 0 for the others, returns the number of visible boxes
+	size_t test(const Frustum& frustum, std::vector<unsigned char>& visible) const;
+
+private:
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+};
+
+#endif
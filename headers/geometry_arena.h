@@ -0,0 +1,72 @@
+#pragma once
+
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+
+#include "cpu_geometry_arena.h"
+#include "vertex_format.h"
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+struct Vertex;
+
+// One vertex buffer and one index buffer shared by all static geometry in a VertexLayout, with a single VAO. Meshes
+// get a GeometryRange in them and are drawn with glDrawElementsBaseVertex, so drawing one after the other binds
+// nothing. When a range does not fit, both buffers grow to twice their size and the old contents are copied over
+// on the GPU; the ranges handed out stay valid.
+class GeometryArena
+{
+public:
+	static const unsigned int INITIAL_VERTICES = 64 * 1024;
+	static const unsigned int INITIAL_INDICES = 3 * INITIAL_VERTICES;
+
+	explicit GeometryArena(const VertexLayout& layout);
+	~GeometryArena();
+
+	// vertex data already in the arena's layout, indices relative to the first vertex
+	GeometryRange add(const void* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount);
+	// packs the vertices into the arena's layout first
+	GeometryRange add(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount);
+	// the range may be handed out again right away, draws already submitted still see the old data
+	void remove(const GeometryRange& range);
+
+	// binds the arena's VAO through glState and draws the range
+	void draw(const GeometryRange& range, GLenum mode = GL_TRIANGLES) const;
+
+	const VertexLayout& getLayout() const { return layout; }
+	unsigned int getVertexArray() const { return VAO; }
+
+	void printStats(std::ostream& out) const;
+
+private:
+	VertexLayout layout;
+	unsigned int VAO, VBO, EBO;
+	RangeAllocator vertices;
+	RangeAllocator indices;
+
+	void growBuffer(unsigned int& buffer, size_t oldSize, size_t newSize);
+
+	GeometryArena(const GeometryArena&);
+	GeometryArena& operator=(const GeometryArena&);
+};
+
+// The arena of every layout in use, created on first use. The arenas own GL objects, so release() has to run while
+// the context exists and after every mesh in them is gone; main calls it before glfwTerminate.
+class GeometryArenas
+{
+public:
+	GeometryArena& get(const VertexLayout& layout);
+	void release();
+	void printStats(std::ostream& out) const;
+
+private:
+	std::vector<std::unique_ptr<GeometryArena> > arenas;
+};
+
+extern GeometryArenas geometryArenas;
+
+#endif
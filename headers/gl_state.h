@@ -0,0 +1,41 @@
+#pragma once
+
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+// Shadow copy of the bindings the render loop changes the most: the program, the active texture unit, the texture
+// bound to each unit and the vertex array. A call that would set what is bound already is skipped, the others go to
+// GL. Both are counted in frameStats.
+// Code binding behind its back (setup code, the texture loader and cache, Shader::use) leaves the copy stale, so
+// Renderer::beginFrame invalidates it at the start of every frame, after the texture uploads.
+class GLState
+{
+public:
+	// units above this are passed through untracked
+	static const unsigned int TEXTURE_UNITS = 16;
+
+	GLState();
+
+	void useProgram(unsigned int program);
+	// selects the unit first when needed. One binding is tracked per unit, the last one of any target.
+	void bindTexture(unsigned int unit, unsigned int target, unsigned int texture);
+	void bindVertexArray(unsigned int vertexArray);
+
+	// forgets every binding, the next call of each kind reaches GL
+	void invalidate();
+
+private:
+	unsigned int program;
+	unsigned int activeUnit;
+	unsigned int vertexArray;
+	unsigned int textureTargets[TEXTURE_UNITS];
+	unsigned int textures[TEXTURE_UNITS];
+
+	void activeTexture(unsigned int unit);
+};
+
+extern GLState glState;
+
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+// Measures the GPU time of the commands between begin() and end() with GL_TIME_ELAPSED queries.
+// Two queries are used in turns, so the result read back is from an earlier frame and the CPU never waits for the GPU.
+// Time elapsed queries cannot be nested, only one timer may be running at a time.
+class GpuTimer
+{
+public:
+	GpuTimer();
+	~GpuTimer();
+
+	void begin();
+	void end();
+
+	// time of the last finished measurement in milliseconds
+	float lastTime() const { return lastTimeMs; }
+
+private:
+	unsigned int queries[2];
+	bool pending[2];
+	int current;
+	float lastTimeMs;
+
+	GpuTimer(const GpuTimer&);
+	GpuTimer& operator=(const GpuTimer&);
+};
+
+#endif
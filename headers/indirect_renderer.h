@@ -0,0 +1,180 @@
+#pragma once
+
+#ifndef INDIRECT_RENDERER_H
+#define INDIRECT_RENDERER_H
+
+#include <glad/glad.h>
+
+#include "glm/glm.hpp"
+
+#include "cpu_geometry_arena.h"
+#include "frustum.h"
+#include "render_queue.h"
+#include "renderer.h"
+#include "shader.h"
+
+#include <vector>
+
+class GeometryArena;
+
+// the layout glDrawElementsIndirect and glMultiDrawElementsIndirect read from the draw indirect buffer
+struct DrawElementsIndirectCommand
+{
+	unsigned int count;
+	unsigned int instanceCount;
+	unsigned int firstIndex;
+	int baseVertex;
+	unsigned int baseInstance;
+};
+
+// Per draw (or per instance) data the vertex shaders fetch from the drawData buffer texture, 8 RGBA32F texels: the
+// model view matrix, the columns of the normal matrix and the material parameters. The mvp is projection * modelView
+// in the shader, the projection comes from the FrameData block.
+struct IndirectDrawData
+{
+	glm::mat4 modelView;
+	glm::vec4 normalMatrix[3];
+	// container_shader multiplies its diffuse map by xyz and its shininess by w, the other programs ignore it
+	glm::vec4 material;
+};
+
+// Collects the opaque draws of a frame into buckets of equal state (program, arena and textures) and submits each
+// bucket with a single glMultiDrawElementsIndirect. The commands are ordered by their RenderQueue keys: the buckets
+// by program, then textures, then vertex array, whatever order they were added in, and the commands of a bucket
+// front to back by their nearest instance. The draw's index reaches the vertex shader through an instanced
+// attribute fed from a buffer holding 0, 1, 2, ..., offset by the command's baseInstance, so the shaders need neither
+// gl_DrawID nor SSBOs and run on the GL 4.0 context. A command may draw many instances of its mesh, each with its
+// own data.
+// Multi draw with a baseInstance is GL 4.3 (or ARB_multi_draw_indirect with ARB_base_instance) and is loaded at
+// runtime. Without it, or with setMultiDraw(false), the same buckets are drawn one command at a time, instanced, with
+// the attribute pointer moved to the command's first instance. That still replaces the three matrix uniforms per draw
+// with one upload per frame.
+// Every draw and instance comes with the bounding box of its mesh. With frustum culling on when they are added, their
+// world space boxes are tested against the camera frustum in flush(), four at a time, and those outside are left out
+// of the upload and the commands. Draws the caller already culled are added with it off and cost no box.
+// Uniforms other than the transforms are program state, set once per bucket by the caller before flush(); draws that
+// need other values have to use another program.
+class IndirectRenderer
+{
+public:
+	// vertex attribute of the draw index and texture unit of the draw data, above the fixed mesh units
+	static const unsigned int DRAW_INDEX_ATTRIBUTE = 7;
+	static const unsigned int DRAW_DATA_UNIT = 16;
+	static const unsigned int TEXELS_PER_DRAW = sizeof(IndirectDrawData) / sizeof(glm::vec4);
+
+	// loader resolves glMultiDrawElementsIndirect, which the GL 4.0 loader does not
+	explicit IndirectRenderer(GLADloadproc loader);
+	~IndirectRenderer();
+
+	bool isMultiDrawSupported() const { return multiDrawElementsIndirect != NULL; }
+	// false draws every command on its own, for comparison, also when multi draw is supported
+	void setMultiDraw(bool enabled) { multiDraw = enabled; }
+	bool usesMultiDraw() const { return multiDraw && isMultiDrawSupported(); }
+	void setPerVertexNormalMatrix(bool enabled) { perVertexNormalMatrix = enabled; }
+	// applies to the draws added after the call
+	void setFrustumCulling(bool enabled) { frustumCulling = enabled; }
+
+	// drops the draws of the previous frame and the buckets nothing was drawn with, the transforms use the frame's camera
+	void begin(const FrameState& frame);
+
+	// state of the draws added after it: the program, the arena holding their geometry and the textures set below
+	void setState(const Shader& shader, const GeometryArena& arena);
+	void setTexture(unsigned int unit, unsigned int target, unsigned int texture);
+	// adds a draw of the range to the bucket of the current state, bounds is the range's box in model space
+	void add(const GeometryRange& range, const BoundingBox& bounds, const glm::mat4& model, const glm::vec4& material = glm::vec4(1.0f));
+	// adds count instances of the range as one command, materials may be NULL for the default of add()
+	void addInstances(const GeometryRange& range, const BoundingBox& bounds, const glm::mat4* models, const glm::vec4* materials, unsigned int count);
+
+	// uploads the commands and draw data of all buckets and draws them, a bucket after the other in key order
+	void flush();
+
+	size_t getBucketCount() const { return buckets.size(); }
+
+private:
+	static const unsigned int NO_BOXES = 0xFFFFFFFF;
+
+	struct BucketTexture
+	{
+		unsigned int unit;
+		unsigned int target;
+		unsigned int texture;
+
+		bool operator==(const BucketTexture& other) const { return unit == other.unit && target == other.target && texture == other.texture; }
+	};
+
+	struct Bucket
+	{
+		unsigned int program;
+		unsigned int vertexArray;
+		std::vector<BucketTexture> textures;
+		int perVertexNormalMatrixLocation;
+		// ids of the program, texture set and vertex array in the sort keys
+		unsigned int shaderId, materialId, vertexArrayId;
+		// a draw was added to it this frame
+		bool used;
+	};
+
+	// a bucket's commands in the staged upload
+	struct Segment
+	{
+		size_t bucket;
+		unsigned int firstCommand;
+		unsigned int commandCount;
+	};
+
+	typedef void (APIENTRYP MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+	MultiDrawElementsIndirectProc multiDrawElementsIndirect;
+	bool multiDraw;
+	bool perVertexNormalMatrix;
+	bool frustumCulling;
+
+	glm::mat4 view;
+	glm::mat4 viewProjection;
+	Frustum frustum;
+
+	std::vector<Bucket> buckets;
+	// the frame's commands in the order they were added, with their bucket, the index of their first draw data and
+	// of their first box, NO_BOXES for commands added without frustum culling
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<unsigned int> commandBuckets;
+	std::vector<unsigned int> commandFirstDraws;
+	std::vector<unsigned int> commandFirstBoxes;
+	std::vector<IndirectDrawData> draws;
+	// world space box of every draw added with frustum culling, and which of them are inside the frustum
+	BoxCuller drawBounds;
+	std::vector<unsigned char> boxesVisible;
+	// the programs, texture sets and vertex arrays of the buckets, their index is their id in the sort keys. Rebuilt
+	// by begin() after dropping the unused buckets.
+	std::vector<unsigned int> programIds;
+	std::vector<std::vector<BucketTexture> > textureSetIds;
+	std::vector<unsigned int> vertexArrayIds;
+	RenderQueue queue;
+	// state set by setState and setTexture, and the bucket of the last add, looked up again once the state changed
+	Bucket pending;
+	const Shader* pendingShader;
+	size_t current;
+	bool stateChanged;
+
+	unsigned int commandBuffer;
+	unsigned int dataBuffer, dataTexture;
+	unsigned int drawIndexBuffer;
+	unsigned int drawIndexCapacity;
+	// draws per upload, the size limit of the buffer texture
+	unsigned int maxStagedDraws;
+	std::vector<unsigned int> preparedVertexArrays;
+
+	std::vector<DrawElementsIndirectCommand> stagedCommands;
+	std::vector<IndirectDrawData> stagedDraws;
+	std::vector<Segment> segments;
+	std::vector<unsigned char> visible;
+
+	size_t findBucket();
+	void assignIds(Bucket& bucket);
+	void prepareVertexArray(unsigned int vertexArray);
+	void submitStaged();
+
+	IndirectRenderer(const IndirectRenderer&);
+	IndirectRenderer& operator=(const IndirectRenderer&);
+};
+
+#endif
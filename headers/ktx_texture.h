@@ -0,0 +1,100 @@
+#pragma once
+
+#ifndef KTX_TEXTURE_H
+#define KTX_TEXTURE_H
+
+#include <glad/glad.h>
+
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// block compressed formats from extensions, the loader is generated for core GL 4.0 without them
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
+
+// Block compressed texture in a KTX 1.1 file: header, then every mip level as an image size followed by the
+// blocks of each face. Only what the texture baker writes is read back: little endian, 2D or cubemap, no array
+// layers and no key/value data.
+// The file is memory mapped, so the levels are handed to glCompressedTexImage2D straight from the mapping.
+class KtxTexture
+{
+public:
+	struct Header
+	{
+		uint32_t endianness;
+		uint32_t glType;
+		uint32_t glTypeSize;
+		uint32_t glFormat;
+		uint32_t glInternalFormat;
+		uint32_t glBaseInternalFormat;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t numberOfArrayElements;
+		uint32_t numberOfFaces;
+		uint32_t numberOfMipmapLevels;
+		uint32_t bytesOfKeyValueData;
+	};
+
+	KtxTexture();
+
+	// maps the file and checks that every level lies inside it
+	bool open(const std::string& path);
+
+	unsigned int getInternalFormat() const { return header->glInternalFormat; }
+	int getWidth() const { return header->pixelWidth; }
+	int getHeight() const { return header->pixelHeight; }
+	int getFaceCount() const { return header->numberOfFaces; }
+	int getLevelCount() const { return header->numberOfMipmapLevels; }
+	// bytes of all levels and faces, the video memory the texture takes
+	size_t getDataSize() const { return dataSize; }
+
+	const unsigned char* getImage(int level, int face) const { return file.data() + levelOffsets[level] + face * (size_t)levelSizes[level]; }
+	uint32_t getImageSize(int level) const { return levelSizes[level]; }
+
+	// reads every page of the mapping, so a later upload does not wait for the disk
+	void touchPages() const;
+	// uploads all levels and faces into the texture, binding it to GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP.
+	// srgb uploads the blocks as the sRGB variant of the format, see srgbFormat.
+	void upload(unsigned int texture, bool srgb = false) const;
+
+	// images are ordered by level, then face: images[level * faces + face]
+	static bool write(const std::string& path, unsigned int internalFormat, unsigned int baseInternalFormat, int width, int height,
+		int faces, const std::vector<std::vector<unsigned char> >& images);
+
+	// whether the current context can sample the format, needs a current GL context
+	static bool isFormatSupported(unsigned int internalFormat);
+	// the sRGB format decoding the same blocks, or 0 when there is none (RGTC holds data, not colours)
+	static unsigned int srgbFormat(unsigned int internalFormat);
+
+private:
+	MappedFile file;
+	const Header* header;
+	std::vector<size_t> levelOffsets;
+	std::vector<uint32_t> levelSizes;
+	size_t dataSize;
+
+	KtxTexture(const KtxTexture&);
+	KtxTexture& operator=(const KtxTexture&);
+};
+
+#endif
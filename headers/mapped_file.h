@@ -0,0 +1,35 @@
+#pragma once
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read only memory mapping of a whole file, the pages are loaded by the OS on first access.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	// false if the file does not exist or cannot be mapped, an empty file cannot be mapped either
+	bool open(const std::string& path);
+	void close();
+
+	const unsigned char* data() const { return bytes; }
+	size_t size() const { return length; }
+
+private:
+	const unsigned char* bytes;
+	size_t length;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#endif
+
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
+
+#endif
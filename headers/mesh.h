@@ -7,14 +7,22 @@
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 
+#include "cpu_geometry_arena.h"
+#include "frame_stats.h"
+#include "frustum.h"
+#include "geometry_arena.h"
+#include "indirect_renderer.h"
 #include "shader.h"
+#include "vertex_format.h"
 
 #include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 
 #define MAX_BONE_INFLUENCE 4
 
+// full precision vertex as it comes from the importer, the VBO stores it in the mesh's VertexLayout
 struct Vertex {
     // position
     glm::vec3 Position;
@@ -38,110 +46,158 @@ struct Texture {
     string path;
 };
 
+// a texture of a mesh resolved for drawing: the unit it is bound to and the location of the sampler reading it,
+// -1 when the program has no such sampler and the texture is not bound at all
+struct TextureBinding {
+    unsigned int unit;
+    unsigned int texture;
+    int location;
+};
+
 class Mesh {
 public:
     // mesh Data
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
-    unsigned int VAO;
-
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    VertexLayout layout;
+    // the shared buffers of the layout the mesh lives in, and its part of them
+    GeometryArena* arena;
+    GeometryRange geometry;
+    unsigned int vertexCount;
+    unsigned int indexCount;
+    // positions and indices in cpuGeometry when the model keeps them there, empty otherwise
+    GeometryRange cpuGeometryRange;
+    // model space box of the vertices, for frustum culling
+    BoundingBox bounds;
+
+    // constructor, the vectors are moved into the mesh, so callers hand theirs over with std::move and nothing is copied
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, VertexLayout layout = VertexLayout())
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), layout(layout)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertexCount = static_cast<unsigned int>(this->vertices.size());
+        this->indexCount = static_cast<unsigned int>(this->indices.size());
+        this->cpuGeometryRange = GeometryRange();
+
+        // the vertices are converted to the mesh's layout, by default packed normals, tangents and uvs
+        vector<unsigned char> vertexData;
+        packVertices(this->vertices.data(), this->vertices.size(), this->layout, vertexData);
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(vertexData.data(), this->indices.data());
+        setupTextureBindings();
     }
 
-    // render the mesh
-    void Draw(Shader& shader)
+    // constructor for geometry already in the GPU layout, e.g. mapped from a model cache, no CPU copy is kept
+    Mesh(const void* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount, vector<Texture> textures, VertexLayout layout)
+        : textures(std::move(textures)), layout(layout)
     {
-        // bind appropriate textures
-        unsigned int diffuseNr = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr = 1;
-        unsigned int heightNr = 1;
-        for (unsigned int i = 0; i < textures.size(); i++)
+        this->vertexCount = vertexCount;
+        this->indexCount = indexCount;
+        this->cpuGeometryRange = GeometryRange();
+        setupMesh(vertexData, indexData);
+        setupTextureBindings();
+    }
+
+    // applies a model's GeometryRetention to the CPU copy once it is no longer needed for the upload or the model
+    // cache, the GPU buffers are not touched. The vectors are swapped out, clear() would keep their memory.
+    void retainGeometry(GeometryRetention retention)
+    {
+        if (retention == GEOMETRY_KEEP)
+            return;
+        if (retention == GEOMETRY_ARENA && !vertices.empty())
+            cpuGeometryRange = cpuGeometry.add(vertices.data(), sizeof(Vertex), vertexCount, indices.data(), indexCount);
+        vector<Vertex>().swap(vertices);
+        vector<unsigned int>().swap(indices);
+    }
+
+    // adds the mesh to the renderer's bucket of the program and its textures, drawn with the others by flush(). The
+    // program has to be in use on the first submit with it, the sampler units are set then.
+    void Submit(Shader& shader, IndirectRenderer& renderer, const glm::mat4& model)
+    {
+        if (bindingsProgram != shader.ID)
+            resolveSamplers(shader);
+
+        renderer.setState(shader, *arena);
+        for (unsigned int i = 0; i < bindings.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if (name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if (name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to string
-            else if (name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to string
-            else if (name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to string
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            if (bindings[i].location >= 0)
+                renderer.setTexture(bindings[i].unit, GL_TEXTURE_2D, bindings[i].texture);
         }
+        renderer.add(geometry, bounds, model);
+    }
 
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    // frees the mesh's part of its arena and of cpuGeometry, it must not be drawn afterwards. Meshes are copied around
+    // while a model is built, so the model calls this for the meshes it ends up owning rather than a destructor.
+    void release()
+    {
+        if (arena)
+            arena->remove(geometry);
+        arena = NULL;
+        cpuGeometry.remove(cpuGeometryRange);
+        cpuGeometryRange = GeometryRange();
     }
 
+    // size of the vertex buffer in bytes and what the full 88 byte Vertex would take
+    size_t vertexBufferSize() const { return (size_t)vertexCount * layout.stride(); }
+    size_t fullVertexBufferSize() const { return (size_t)vertexCount * sizeof(Vertex); }
+    size_t indexBufferSize() const { return (size_t)indexCount * sizeof(unsigned int); }
+    // bytes held by the CPU copy of the vertices and indices
+    size_t cpuGeometrySize() const { return vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int); }
+
 private:
-    // render data 
-    unsigned int VBO, EBO;
+    // textures with their units, and the sampler name of each (texture_diffuseN and so on)
+    vector<TextureBinding> bindings;
+    vector<string> samplerNames;
+    // program the sampler locations in bindings belong to, 0 before the first submit
+    unsigned int bindingsProgram;
+
+    // Every sampler name gets a fixed unit: texture_diffuseN unit N - 1, texture_specularN 4 + N - 1, texture_normalN
+    // 8 + N - 1 and texture_heightN 12 + N - 1. So the value of a sampler uniform is the same for every mesh, it is set
+    // once per program, and meshes sharing a texture leave its unit bound. Textures past the fourth of a type are dropped.
+    void setupTextureBindings()
+    {
+        static const char* const types[] = { "texture_diffuse", "texture_specular", "texture_normal", "texture_height" };
+        unsigned int counts[4] = { 0, 0, 0, 0 };
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            for (unsigned int type = 0; type < 4; type++)
+            {
+                if (textures[i].type != types[type] || counts[type] == 4)
+                    continue;
+                TextureBinding binding;
+                binding.unit = 4 * type + counts[type]++;
+                binding.texture = textures[i].id;
+                binding.location = -1;
+                bindings.push_back(binding);
+                samplerNames.push_back(textures[i].type + std::to_string(counts[type]));
+            }
+        }
+        bindingsProgram = 0;
+    }
+
+    // looks the samplers up in the program and points them at their units
+    void resolveSamplers(Shader& shader)
+    {
+        for (unsigned int i = 0; i < bindings.size(); i++)
+        {
+            bindings[i].location = shader.getUniformLocation(samplerNames[i]);
+            if (bindings[i].location >= 0)
+            {
+                shader.setInt(bindings[i].location, (int)bindings[i].unit);
+                frameStats.glCalls++;
+            }
+        }
+        bindingsProgram = shader.ID;
+    }
 
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    // copies the vertices and indices into the arena of the mesh's layout, which owns the buffers and the VAO. The
+    // bounds are taken from the same data, so meshes loaded from a model cache get them too.
+    void setupMesh(const void* vertexData, const unsigned int* indexData)
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-        // ids
-        glEnableVertexAttribArray(5);
-        glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
-
-        // weights
-        glEnableVertexAttribArray(6);
-        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
-        glBindVertexArray(0);
+        bounds = BoundingBox::fromPositions(vertexData, layout.stride(), vertexCount);
+        arena = &geometryArenas.get(layout);
+        geometry = arena->add(vertexData, vertexCount, indexData, indexCount);
     }
 };
 #endif
\ No newline at end of file
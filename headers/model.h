@@ -6,14 +6,22 @@
 
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
 #include "stb_image.h"
+#include <assimp/DefaultIOSystem.h>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
 #include "mesh.h"
+#include "model_cache.h"
+#include "scene_graph.h"
 #include "shader.h"
+#include "texture_cache.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -22,36 +30,153 @@
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
+inline unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
+
+// Assimp's file access, remembering the files an import opened besides the model itself, like the material library
+// of an .obj. The model cache keeps their hashes.
+class DependencyRecorder : public Assimp::DefaultIOSystem
+{
+public:
+    explicit DependencyRecorder(const string& modelPath) : modelPath(modelPath) {}
+
+    using Assimp::DefaultIOSystem::Open;
+    Assimp::IOStream* Open(const char* file, const char* mode = "rb") override
+    {
+        Assimp::IOStream* stream = Assimp::DefaultIOSystem::Open(file, mode);
+        if (stream && modelPath != file && find(dependencies.begin(), dependencies.end(), file) == dependencies.end())
+            dependencies.push_back(file);
+        return stream;
+    }
+
+    const vector<string>& getDependencies() const { return dependencies; }
+
+private:
+    string modelPath;
+    vector<string> dependencies;
+};
 
 class Model
 {
 public:
     // model data 
     vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+                                        // with a texture cache it holds one entry per reference taken from the cache instead.
     vector<Mesh>    meshes;
+    // the node hierarchy of the file with the transforms assimp read for each node, see ModelNode
+    vector<ModelNode> nodes;
     string directory;
     bool gammaCorrection;
+    // vertex layout of the meshes, bones are only added to meshes that have them
+    VertexLayout layout;
+    // true when the meshes came from the binary cache instead of assimp
+    bool loadedFromCache;
+    // seconds spent loading textures, reported separately from the geometry by --bench-model-load
+    double textureLoadTime;
+    // when set, textures come from the cache shared with other models and the scene, new ones are only queued on its
+    // loader and their images arrive while it streams. gammaCorrection then loads diffuse textures as sRGB.
+    TextureCache* textureCache;
+    // CPU copy of the geometry kept once the meshes are uploaded, see GeometryRetention
+    GeometryRetention retention;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const& path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const& path, bool gamma = false, VertexLayout layout = VertexLayout(), TextureCache* textureCache = NULL,
+        GeometryRetention retention = GEOMETRY_KEEP)
+        : gammaCorrection(gamma), layout(layout), loadedFromCache(false), textureLoadTime(0.0), textureCache(textureCache), retention(retention)
     {
         loadModel(path);
+        printVertexBufferSavings(path);
+        printMemoryReport(path);
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader& shader)
+    // frees the meshes' geometry for the next model and hands the textures back to the cache, which keeps them for
+    // other models until it needs the memory
+    ~Model()
     {
         for (unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+            meshes[i].release();
+        for (unsigned int i = 0; textureCache && i < textures_loaded.size(); i++)
+            textureCache->release(textures_loaded[i].id);
+    }
+
+    // adds a scene graph node under parent for every node of the model, sceneNodes[i] is the one of nodes[i]
+    void addToScene(SceneGraph& graph, unsigned int parent, vector<unsigned int>& sceneNodes) const
+    {
+        sceneNodes.resize(nodes.size());
+        for (unsigned int i = 0; i < nodes.size(); i++)
+            sceneNodes[i] = graph.add(nodes[i].transform, nodes[i].parent < 0 ? parent : sceneNodes[nodes[i].parent]);
+    }
+
+    // adds every mesh to the renderer with the world matrix of its node, they are drawn by its flush()
+    void Submit(Shader& shader, IndirectRenderer& renderer, const SceneGraph& graph, const vector<unsigned int>& sceneNodes)
+    {
+        for (unsigned int i = 0; i < nodes.size(); i++)
+        {
+            const glm::mat4& world = graph.getWorld(sceneNodes[i]);
+            for (unsigned int m = nodes[i].firstMesh; m < nodes[i].firstMesh + nodes[i].meshCount; m++)
+                meshes[m].Submit(shader, renderer, world);
+        }
+    }
+
+    // model space box around all meshes, placed by their nodes
+    BoundingBox getBounds() const
+    {
+        BoundingBox bounds;
+        vector<glm::mat4> transforms(nodes.size());
+        for (unsigned int i = 0; i < nodes.size(); i++)
+        {
+            transforms[i] = nodes[i].parent < 0 ? nodes[i].transform : transforms[nodes[i].parent] * nodes[i].transform;
+            for (unsigned int m = nodes[i].firstMesh; m < nodes[i].firstMesh + nodes[i].meshCount; m++)
+                bounds.add(meshes[m].bounds.transformed(transforms[i]));
+        }
+        return bounds;
     }
 
 private:
+    void printVertexBufferSavings(string const& path) const
+    {
+        size_t bytes = 0, fullBytes = 0;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            bytes += meshes[i].vertexBufferSize();
+            fullBytes += meshes[i].fullVertexBufferSize();
+        }
+        if (fullBytes == 0)
+            return;
+        cout << path << ": vertex buffers " << bytes / 1024 << " KB, " << fullBytes / 1024 << " KB with the full vertex, saved "
+            << (fullBytes - bytes) / 1024 << " KB (" << 100 * (fullBytes - bytes) / fullBytes << "%)" << endl;
+    }
+
+    void printMemoryReport(string const& path) const
+    {
+        static const char* const retentionNames[] = { "kept", "dropped", "in the shared arena" };
+        size_t gpuBytes = 0, cpuBytes = 0, arenaBytes = 0;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            gpuBytes += meshes[i].vertexBufferSize() + meshes[i].indexBufferSize();
+            cpuBytes += meshes[i].cpuGeometrySize();
+            arenaBytes += meshes[i].cpuGeometryRange.vertexCount * sizeof(glm::vec3) + meshes[i].cpuGeometryRange.indexCount * sizeof(unsigned int);
+        }
+        cout << path << ": " << meshes.size() << " meshes, gpu geometry " << gpuBytes / 1024 << " KB, cpu geometry "
+            << retentionNames[retention] << ": " << cpuBytes / 1024 << " KB in the meshes, " << arenaBytes / 1024 << " KB in the arena" << endl;
+    }
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // the first import writes path + ".cache", later runs read the meshes from it as long as the source file and the
+    // files assimp read with it, like its material library, are unchanged.
     void loadModel(string const& path)
     {
-        // read file via ASSIMP
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        uint64_t sourceHash = 0;
+        bool hashed = ModelCache::hashFile(path, sourceHash);
+        if (hashed && loadFromCache(ModelCache::cachePath(path), sourceHash))
+            return;
+
+        // read file via ASSIMP, the importer owns the recorder
         Assimp::Importer importer;
+        DependencyRecorder* recorder = new DependencyRecorder(path);
+        importer.SetIOHandler(recorder);
         const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
         // check for errors
         if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
@@ -59,16 +184,67 @@ private:
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
             return;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        meshes.reserve(scene->mNumMeshes);
+        processNode(scene->mRootNode, scene, -1);
+
+        if (hashed && !ModelCache::write(ModelCache::cachePath(path), sourceHash, layout, meshes, nodes, recorder->getDependencies()))
+            cout << "Failed to write model cache: " << ModelCache::cachePath(path) << endl;
+
+        // the cache writer was the last user of the full vertices
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].retainGeometry(retention);
+    }
+
+    // builds the meshes from a valid cache, the GL buffers are filled directly from the mapped file
+    bool loadFromCache(string const& cachePath, uint64_t sourceHash)
+    {
+        ModelCache cache;
+        if (!cache.open(cachePath, sourceHash, layout))
+            return false;
+
+        meshes.reserve(cache.getMeshCount());
+        for (unsigned int i = 0; i < cache.getMeshCount(); i++)
+        {
+            const ModelCacheMesh& record = cache.getMesh(i);
+            vector<Texture> textures;
+            textures.reserve(record.textureCount);
+            for (unsigned int t = record.firstTexture; t < record.firstTexture + record.textureCount; t++)
+            {
+                const ModelCacheTexture& texture = cache.getTexture(t);
+                textures.push_back(getTexture(cache.getString(texture.path), cache.getString(texture.type)));
+            }
+
+            VertexLayout meshLayout = layout;
+            meshLayout.bones = record.bones != 0;
+            meshes.push_back(Mesh(cache.getVertexData(record), record.vertexCount, cache.getIndexData(record), record.indexCount, std::move(textures), meshLayout));
+            // cached meshes have no CPU copy to keep, the arena takes the positions straight from the mapping
+            if (retention == GEOMETRY_ARENA)
+                meshes.back().cpuGeometryRange = cpuGeometry.add(cache.getVertexData(record), meshLayout.stride(), record.vertexCount,
+                    cache.getIndexData(record), record.indexCount);
+        }
+        nodes.reserve(cache.getNodeCount());
+        for (unsigned int i = 0; i < cache.getNodeCount(); i++)
+            nodes.push_back(cache.getNode(i));
+        loadedFromCache = true;
+        return true;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode* node, const aiScene* scene)
+    // the node is added before its children, so parents come first in nodes and the meshes of a node stay together
+    void processNode(aiNode* node, const aiScene* scene, int parent)
     {
+        ModelNode modelNode;
+        // assimp stores the matrix row by row, glm column by column
+        modelNode.transform = glm::transpose(glm::make_mat4(&node->mTransformation.a1));
+        modelNode.parent = parent;
+        modelNode.firstMesh = (uint32_t)meshes.size();
+        modelNode.meshCount = node->mNumMeshes;
+        modelNode.padding = 0;
+        int index = (int)nodes.size();
+        nodes.push_back(modelNode);
+
         // process each mesh located at the current node
         for (unsigned int i = 0; i < node->mNumMeshes; i++)
         {
@@ -80,22 +256,29 @@ private:
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for (unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, index);
         }
 
     }
 
     Mesh processMesh(aiMesh* mesh, const aiScene* scene)
     {
-        // data to fill
+        // data to fill, sized up front: after aiProcess_Triangulate every face has three indices
         vector<Vertex> vertices;
         vector<unsigned int> indices;
         vector<Texture> textures;
+        vertices.reserve(mesh->mNumVertices);
+        indices.reserve(mesh->mNumFaces * 3);
 
         // walk through each of the mesh's vertices
         for (unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
             Vertex vertex;
+            for (int k = 0; k < MAX_BONE_INFLUENCE; k++)
+            {
+                vertex.m_BoneIDs[k] = -1;
+                vertex.m_Weights[k] = 0.0f;
+            }
             glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
             // positions
             vector.x = mesh->mVertices[i].x;
@@ -131,14 +314,36 @@ private:
                 vertex.Bitangent = vector;
             }
             else
+            {
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+                vertex.Tangent = glm::vec3(0.0f);
+                vertex.Bitangent = glm::vec3(0.0f);
+            }
 
             vertices.push_back(vertex);
         }
+        // bone influences, the first MAX_BONE_INFLUENCE weights of every vertex are kept
+        for (unsigned int b = 0; b < mesh->mNumBones; b++)
+        {
+            const aiBone* bone = mesh->mBones[b];
+            for (unsigned int w = 0; w < bone->mNumWeights; w++)
+            {
+                Vertex& vertex = vertices[bone->mWeights[w].mVertexId];
+                for (int k = 0; k < MAX_BONE_INFLUENCE; k++)
+                {
+                    if (vertex.m_BoneIDs[k] < 0)
+                    {
+                        vertex.m_BoneIDs[k] = b;
+                        vertex.m_Weights[k] = bone->mWeights[w].mWeight;
+                        break;
+                    }
+                }
+            }
+        }
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
         for (unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
-            aiFace face = mesh->mFaces[i];
+            const aiFace& face = mesh->mFaces[i];
             // retrieve all indices of the face and store them in the indices vector
             for (unsigned int j = 0; j < face.mNumIndices; j++)
                 indices.push_back(face.mIndices[j]);
@@ -166,45 +371,66 @@ private:
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        VertexLayout meshLayout = layout;
+        meshLayout.bones = mesh->HasBones();
+        return Mesh(std::move(vertices), std::move(indices), std::move(textures), meshLayout);
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
     // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
+    vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string const& typeName)
     {
         vector<Texture> textures;
+        textures.reserve(mat->GetTextureCount(type));
         for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for (unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if (!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
-            }
+            textures.push_back(getTexture(str.C_Str(), typeName));
         }
         return textures;
     }
+
+    // returns the texture at the given path, loading it only if it wasn't loaded yet
+    Texture getTexture(const char* path, string const& typeName)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (textureCache)
+        {
+            // a hashed lookup across all models, every texture of every mesh takes its own reference
+            TextureCache::ColorSpace colorSpace = gammaCorrection && typeName == "texture_diffuse" ? TextureCache::COLOR_SRGB : TextureCache::COLOR_LINEAR;
+            Texture texture;
+            texture.id = textureCache->acquire2D(this->directory + '/' + path, colorSpace);
+            texture.type = typeName;
+            texture.path = path;
+            textures_loaded.push_back(texture);
+            textureLoadTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return texture;
+        }
+
+        // check if texture was loaded before and if so, skip loading a new texture
+        for (unsigned int j = 0; j < textures_loaded.size(); j++)
+        {
+            if (std::strcmp(textures_loaded[j].path.data(), path) == 0)
+                return textures_loaded[j]; // a texture with the same filepath has already been loaded (optimization)
+        }
+        // if texture hasn't been loaded already, load it
+        Texture texture;
+        texture.id = TextureFromFile(path, this->directory);
+        texture.type = typeName;
+        texture.path = path;
+        textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
+        textureLoadTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return texture;
+    }
+
+    // a copy would release the cache references twice
+    Model(const Model&);
+    Model& operator=(const Model&);
 };
 
 
-unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
+inline unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
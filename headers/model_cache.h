@@ -0,0 +1,113 @@
+#pragma once
+
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include "mesh.h"
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary cache of an imported model, written next to the source file after the first Assimp import.
+// File layout: header | mesh records | texture references | nodes | dependencies | string table | vertex and index
+// blobs.
+// Blobs are 16 byte aligned and the vertices are already in the mesh's VertexLayout, so a warm start maps the file
+// and hands the blobs to glBufferData without any parsing or copying on the CPU.
+// The cache is rebuilt when the version, the vertex layout or the hash of the source file or of one of the files the
+// import read with it changes.
+
+struct ModelCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceHash;
+	uint32_t layoutFlags;
+	uint32_t meshCount;
+	uint32_t textureCount;
+	uint32_t stringTableSize;
+	uint64_t stringTableOffset;
+	uint32_t nodeCount;
+	uint32_t dependencyCount;
+};
+
+struct ModelCacheMesh
+{
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t bones;
+	// material table, textures [firstTexture, firstTexture + textureCount)
+	uint32_t firstTexture;
+	uint32_t textureCount;
+	uint32_t padding;
+};
+
+// A node of the model's hierarchy, stored in the cache as it is in memory. Parents come before their children,
+// transform is relative to the parent and the node's meshes are [firstMesh, firstMesh + meshCount).
+struct ModelNode
+{
+	glm::mat4 transform;
+	int32_t parent;
+	uint32_t firstMesh;
+	uint32_t meshCount;
+	uint32_t padding;
+};
+
+// offsets into the string table
+struct ModelCacheTexture
+{
+	uint32_t type;
+	uint32_t path;
+};
+
+// a file the import read besides the model, like the material library of an .obj, with its FNV-1a hash; path is an
+// offset into the string table
+struct ModelCacheDependency
+{
+	uint32_t path;
+	uint32_t padding;
+	uint64_t hash;
+};
+
+class ModelCache
+{
+public:
+	static const uint32_t VERSION = 3;
+
+	// FNV-1a of the file contents, false if it cannot be read
+	static bool hashFile(const std::string& path, uint64_t& hash);
+	static std::string cachePath(const std::string& sourcePath) { return sourcePath + ".cache"; }
+
+	ModelCache();
+
+	// maps the cache and checks it against the source and its dependencies, which are hashed again, false when it is
+	// missing, stale or damaged
+	bool open(const std::string& path, uint64_t sourceHash, const VertexLayout& layout);
+
+	unsigned int getMeshCount() const { return header->meshCount; }
+	const ModelCacheMesh& getMesh(unsigned int index) const { return meshes[index]; }
+	const ModelCacheTexture& getTexture(unsigned int index) const { return textures[index]; }
+	unsigned int getNodeCount() const { return header->nodeCount; }
+	const ModelNode& getNode(unsigned int index) const { return nodes[index]; }
+	const char* getString(uint32_t offset) const { return strings + offset; }
+	const unsigned char* getVertexData(const ModelCacheMesh& mesh) const { return file.data() + mesh.vertexOffset; }
+	const unsigned int* getIndexData(const ModelCacheMesh& mesh) const { return (const unsigned int*)(file.data() + mesh.indexOffset); }
+
+	// dependencies are the paths of the other files the import read, they are hashed here
+	static bool write(const std::string& path, uint64_t sourceHash, const VertexLayout& layout, const std::vector<Mesh>& meshes,
+		const std::vector<ModelNode>& nodes, const std::vector<std::string>& dependencies);
+
+private:
+	MappedFile file;
+	const ModelCacheHeader* header;
+	const ModelCacheMesh* meshes;
+	const ModelCacheTexture* textures;
+	const ModelNode* nodes;
+	const ModelCacheDependency* dependencies;
+	const char* strings;
+};
+
+#endif
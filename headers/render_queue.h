@@ -0,0 +1,63 @@
+#pragma once
+
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// the passes in the order they are drawn
+enum RenderPass
+{
+	OPAQUE_PASS = 0,
+	TRANSPARENT_PASS = 1
+};
+
+// The draws of a frame, each under a 64 bit sort key, sorted so that draws with the same state follow each other.
+// Opaque keys hold, from the top bits down: the pass, the shader, the material (texture set), the vertex array and
+// the view depth, so a state is switched once and its draws go front to back for the depth test. Transparent draws
+// have to blend back to front whatever their state, their keys hold the pass, the inverted depth and the state below
+// it.
+// The shader, material and vertex array are small ids of the caller, the bits above their width are dropped.
+class RenderQueue
+{
+public:
+	static const unsigned int SHADER_BITS = 10;
+	static const unsigned int MATERIAL_BITS = 12;
+	static const unsigned int VERTEX_ARRAY_BITS = 8;
+
+	// depth is the distance along the view direction, negative depths count as 0
+	static uint64_t makeKey(RenderPass pass, unsigned int shader, unsigned int material, unsigned int vertexArray, float depth);
+	static RenderPass getPass(uint64_t key) { return (RenderPass)(key >> 62); }
+	// shader, material and vertex array bits of the key, equal for draws that need no state change in between
+	static unsigned int getState(uint64_t key);
+
+	void clear() { entries.clear(); }
+	void reserve(size_t count) { entries.reserve(count); }
+	// item is the caller's index of the draw
+	void push(uint64_t key, unsigned int item);
+
+	// stable LSD radix sort, 8 bits per pass; passes where every key has the same byte are skipped
+	void sort();
+
+	size_t size() const { return entries.size(); }
+	uint64_t getKey(size_t index) const { return entries[index].key; }
+	unsigned int getItem(size_t index) const { return entries[index].item; }
+
+	// shader, material and vertex array switches drawing the entries in their current order, the first draw sets all
+	// three
+	unsigned int countStateChanges() const;
+
+private:
+	struct Entry
+	{
+		uint64_t key;
+		unsigned int item;
+	};
+
+	std::vector<Entry> entries;
+	std::vector<Entry> scratch;
+};
+
+#endif
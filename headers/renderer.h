@@ -0,0 +1,118 @@
+#pragma once
+
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <glad/glad.h>
+
+#include "glm/glm.hpp"
+
+#include "shader.h"
+#include "uniform_buffers.h"
+
+// Light and fog parameters in world space. Cutoffs are stored as cosines so they are computed once, not per draw.
+struct DirLightState
+{
+	glm::vec3 direction;
+	glm::vec3 ambient;
+	glm::vec3 diffuse;
+	glm::vec3 specular;
+};
+
+struct PointLightState
+{
+	glm::vec3 position;
+	glm::vec3 ambient;
+	glm::vec3 diffuse;
+	glm::vec3 specular;
+	float constant;
+	float linear;
+	float quadratic;
+};
+
+struct FlashlightState
+{
+	glm::vec3 position;
+	glm::vec3 direction;
+	glm::vec3 ambient;
+	glm::vec3 diffuse;
+	glm::vec3 specular;
+	float constant;
+	float linear;
+	float quadratic;
+	float cutOff;
+	float outerCutOff;
+};
+
+struct FogState
+{
+	bool isOn;
+	float expDensity;
+	float end;
+	glm::vec3 color;
+};
+
+// Snapshot of everything shared by the draws of one frame. Filled once per frame, before any object is submitted.
+struct FrameState
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	glm::vec3 cameraPosition;
+	// framebuffer size in pixels
+	glm::vec2 viewportSize;
+	float time;
+
+	DirLightState dirLight;
+	PointLightState pointLights[NR_POINT_LIGHTS];
+	FlashlightState flashlights[NR_FLASHLIGHTS];
+	FogState fog;
+};
+
+// Uniform locations of the per draw transforms, resolved once per program. Programs without one of them get -1.
+struct TransformLocations
+{
+	int modelView;
+	int mvp;
+	int normalMatrix;
+	int perVertexNormalMatrix;
+
+	TransformLocations();
+	explicit TransformLocations(const Shader& shader);
+};
+
+// Per draw transforms computed on the CPU, so the shaders do not have to invert a matrix per vertex.
+struct DrawTransforms
+{
+	glm::mat4 modelView;
+	glm::mat4 mvp;
+	glm::mat3 normalMatrix;
+};
+
+void computeDrawTransforms(const glm::mat4& view, const glm::mat4& viewProjection, const glm::mat4& model, DrawTransforms& out);
+
+class Renderer
+{
+public:
+	Renderer();
+
+	// converts the frame state to the shared uniform blocks and uploads them, call once per frame before drawing
+	void beginFrame(const FrameState& state);
+
+	// per object submission, only the per object data is touched
+	void useShader(const Shader& shader);
+	void setTransforms(const Shader& shader, const TransformLocations& locations, const glm::mat4& model) const;
+
+	// comparison mode: the shaders compute the normal matrix per vertex again, as they used to
+	void setPerVertexNormalMatrix(bool enabled) { perVertexNormalMatrix = enabled; }
+	bool usesPerVertexNormalMatrix() const { return perVertexNormalMatrix; }
+
+	const FrameState& frame() const { return state; }
+
+private:
+	SceneUniformBuffer uniforms;
+	FrameState state;
+	bool perVertexNormalMatrix;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#pragma once
+
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include "glm/glm.hpp"
+
+#include <vector>
+
+// Parent and child transforms of the scene's objects. Every node has a local matrix, relative to its parent, and a
+// cached world matrix that update() only recomputes when the local matrix or one of the ancestors changed.
+// The nodes live in separate arrays sorted by depth, so every parent comes before its children and update() is a
+// single forward sweep over them. A node keeps its handle when the arrays are sorted again after adding nodes
+// above deeper ones.
+class SceneGraph
+{
+public:
+	static const unsigned int NO_PARENT = 0xffffffff;
+
+	SceneGraph();
+
+	// a new node under parent (NO_PARENT for a root), its world matrix is valid after the next update()
+	unsigned int add(const glm::mat4& local, unsigned int parent = NO_PARENT);
+	void setLocal(unsigned int node, const glm::mat4& local);
+	const glm::mat4& getLocal(unsigned int node) const { return locals[slots[node]]; }
+
+	// recomputes the world matrices of the changed nodes and their descendants, returns how many there were
+	unsigned int update();
+	const glm::mat4& getWorld(unsigned int node) const { return worlds[slots[node]]; }
+	// true when the last update() recomputed the node's world matrix
+	bool worldChanged(unsigned int node) const { return changed[slots[node]] != 0; }
+
+	size_t size() const { return locals.size(); }
+
+private:
+	// per slot, in depth order; parents holds slots too
+	std::vector<glm::mat4> locals;
+	std::vector<glm::mat4> worlds;
+	std::vector<unsigned int> parents;
+	std::vector<unsigned int> depths;
+	std::vector<unsigned char> dirty;
+	std::vector<unsigned char> changed;
+	// handle of every slot and slot of every handle
+	std::vector<unsigned int> nodes;
+	std::vector<unsigned int> slots;
+	bool sorted;
+
+	void sortByDepth();
+};
+
+#endif
@@ -13,6 +13,7 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
 
 class Shader
 {
@@ -24,14 +25,32 @@ public:
 
 	void use();
 
+	// binds a uniform block to a fixed binding point, does nothing if the program does not use the block
+	void bindUniformBlock(const std::string &name, unsigned int binding) const;
+
+	// returns the location cached after linking, -1 if the uniform is not active in this program
+	int getUniformLocation(const std::string &name) const;
+
 	void setBool(const std::string &name, bool value) const;
 	void setInt(const std::string &name, int value) const;
 	void setFloat(const std::string &name, float value) const;
 	void setMat4(const std::string &name, glm::mat4 value) const;
 	void setVec3(const std::string &name, glm::vec3 value) const;
 
+	// location based setters for the render loop, locations come from getUniformLocation
+	void setBool(int location, bool value) const;
+	void setInt(int location, int value) const;
+	void setFloat(int location, float value) const;
+	void setMat3(int location, const glm::mat3 &value) const;
+	void setMat4(int location, const glm::mat4 &value) const;
+	void setVec3(int location, const glm::vec3 &value) const;
+
 private:
+	// name -> location of every active uniform, filled once after linking
+	std::unordered_map<std::string, int> uniformLocations;
+
 	void checkCompileErrors(unsigned int shader, std::string type);
+	void cacheUniformLocations();
 };
 
 #endif
\ No newline at end of file
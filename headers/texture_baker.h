@@ -0,0 +1,15 @@
+#pragma once
+
+#ifndef TEXTURE_BAKER_H
+#define TEXTURE_BAKER_H
+
+#include <string>
+
+// --bake-textures [directory] [--bc7]: converts every .jpg and .png under the directory (resources/ by default)
+// into a block compressed KTX file next to it (image.png -> image.png.ktx) with a full mip chain built on the CPU.
+// A directory holding the six skybox faces becomes one cubemap.ktx instead. Formats: BC5 for files with "normal"
+// in their name, BC3 for images with transparent texels and BC1 for the rest, --bc7 uses BC7 for colour images.
+// Prints the video memory and the CPU load time of every file before and after, no GL context is needed.
+int runTextureBaker(const std::string& directory, bool bc7);
+
+#endif
@@ -0,0 +1,92 @@
+#pragma once
+
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+class TextureLoader;
+
+// Process wide cache in front of a TextureLoader, shared by the scene and every model, so a file that many models
+// use is decoded and uploaded once. Textures are found in a hash map by canonical path (see canonicalPath), colour
+// space, the loader's flip setting and whether they are cubemaps; the same file in sRGB and linear is two textures.
+// acquire2D and acquireCubemap hand out a reference, release drops it. A texture without references stays cached and
+// is handed out again by the next acquire, until the cached textures take more video memory than the budget: then
+// the least recently used unreferenced ones are deleted. Referenced textures are never evicted, they alone can
+// exceed the budget.
+// Sizes are read back from GL once the loader has finished streaming. Nothing is evicted while it streams, as it may
+// still upload into any texture it was given, and textures it has not finished count as nothing until then.
+class TextureCache
+{
+public:
+	enum ColorSpace
+	{
+		COLOR_LINEAR,
+		COLOR_SRGB
+	};
+
+	static const size_t DEFAULT_BUDGET = 512 * 1024 * 1024;
+
+	explicit TextureCache(TextureLoader* loader, size_t budget = DEFAULT_BUDGET);
+	// deletes every cached texture, referenced or not, needs the GL context current
+	~TextureCache();
+
+	// the cached texture or a new one queued on the loader, which has to stream it like its other textures
+	unsigned int acquire2D(const std::string& path, ColorSpace colorSpace = COLOR_LINEAR);
+	// directory ends with '/', as for TextureLoader::addCubemap
+	unsigned int acquireCubemap(const std::string& directory, ColorSpace colorSpace = COLOR_LINEAR);
+	// drops a reference taken by acquire, names the cache did not hand out are ignored
+	void release(unsigned int texture);
+
+	void setBudget(size_t bytes);
+	size_t getBudget() const { return budget; }
+	// estimated video memory of the cached textures
+	size_t getResidentBytes() const { return residentBytes; }
+
+	// measures finished textures and evicts down to the budget, acquire and release do this on their own. Call it
+	// once after a stream finishes so the textures it loaded are counted.
+	void trim();
+
+	// cached textures, references, hit rate and evictions
+	void printReport(std::ostream& out) const;
+
+	// absolute, '/' separated path without "." and ".." segments or repeated separators; lowercase on Windows, where
+	// file names are case insensitive. A trailing '/' is kept. Symbolic links are not resolved.
+	static std::string canonicalPath(const std::string& path);
+
+private:
+	struct Entry
+	{
+		unsigned int name;
+		bool cubemap;
+		ColorSpace colorSpace;
+		int references;
+		// estimated video memory, valid once measured
+		size_t bytes;
+		bool measured;
+		// value of useCounter at the last acquire or release, the smallest is evicted first
+		unsigned long long lastUse;
+	};
+
+	typedef std::unordered_map<std::string, Entry> EntryMap;
+
+	TextureLoader* loader;
+	EntryMap entries;
+	// texture name to its key in entries, for release
+	std::unordered_map<unsigned int, std::string> keys;
+	size_t budget;
+	size_t residentBytes;
+	unsigned long long useCounter;
+	int hits, misses, evictions;
+
+	unsigned int acquire(const std::string& path, bool cubemap, ColorSpace colorSpace);
+	void evict(const std::string& key);
+
+	TextureCache(const TextureCache&);
+	TextureCache& operator=(const TextureCache&);
+};
+
+#endif
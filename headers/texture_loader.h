@@ -0,0 +1,150 @@
+#pragma once
+
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+
+#include "ktx_texture.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ThreadPool;
+
+// Streams the textures of a scene in. add2D and addCubemap create the GL texture with a 1x1 grey placeholder and
+// queue the image files, so the returned names can be handed out and drawn with right away. startStreaming()
+// decodes the images with stb_image on the thread pool in the background, and update(), called once per frame on
+// the GL thread, copies the decoded rows into a ring of pixel buffer regions and uploads them from there.
+// A texture keeps showing its placeholder until all of its rows are uploaded: the full size level 0 is filled while
+// the texture samples a 1x1 copy of the placeholder at its last mip level (base and max level point there), then
+// the base level is moved back to 0 and the mipmaps are generated.
+// Each region is guarded by a fence like the flag's vertex upload ring. GL 4.0 has no persistent mapping, so a
+// region is mapped unsynchronized for each upload instead, and a region the GPU still reads is skipped until the
+// next frame rather than waited for.
+// Textures baked with --bake-textures (see texture_baker.h) are used instead of their sources when the format is
+// supported: the KTX file is mapped on the pool and all of its levels are uploaded in one update(). Flipped images
+// always come from their sources, the blocks are stored in the orientation of the file.
+class TextureLoader
+{
+public:
+	static const int UPLOAD_REGIONS = 3;
+	// at most one region is filled per update(), a 4K RGB texture takes six frames
+	static const size_t REGION_SIZE = 8 * 1024 * 1024;
+
+	// the cubemap face files in the order of the GL faces
+	static const char* const CUBEMAP_FACES[6];
+	static std::string bakedPath(const std::string& path) { return path + ".ktx"; }
+	static std::string bakedCubemapPath(const std::string& directory) { return directory + "cubemap.ktx"; }
+
+	// NULL decodes on the background thread alone
+	explicit TextureLoader(ThreadPool* pool);
+	~TextureLoader();
+
+	// applies to the images queued after the call. stbi_set_flip_vertically_on_load is ignored by the loader, and no
+	// longer affects the threads it decoded on, they load unflipped from then on.
+	void setFlipVertically(bool flip) { flipVertically = flip; }
+	bool getFlipVertically() const { return flipVertically; }
+
+	// Called on the GL thread. Images queued while a stream is running wait for the next one, which starts as soon as
+	// the running stream ends. srgb stores colour images as GL_SRGB8(_ALPHA8), or as the sRGB variant of a baked
+	// format, so sampling returns linear values. One and two channel images stay linear.
+	// mipmapped, repeating 2D texture
+	unsigned int add2D(const std::string& path, bool srgb = false);
+	// cubemap from right, left, top, bottom, front and back .jpg in the directory (path ends with '/')
+	unsigned int addCubemap(const std::string& directory, bool srgb = false);
+
+	// starts decoding everything queued so far, the textures arrive with the following update() calls
+	void startStreaming();
+	// uploads the next rows of decoded images, needs the GL context current. Returns the textures completed.
+	int update();
+	bool isStreaming() const { return streaming; }
+	// nothing queued or streaming, every texture handed out so far has its image or failed to load
+	bool isIdle() const { return images.empty() && queuedImages.empty(); }
+
+	// streams everything queued and returns once all of it is uploaded
+	void finish();
+
+	// per file decode interval and upload time (both relative to startStreaming) of the last finished stream
+	void printTimeline(std::ostream& out) const;
+
+private:
+	typedef std::chrono::steady_clock clock;
+
+	struct Image
+	{
+		std::string path;
+		bool flip;
+		// index into textures, and GL_TEXTURE_2D or the cubemap face
+		int texture;
+		unsigned int target;
+
+		unsigned char* data;
+		int width, height, components;
+		int rowsUploaded;
+		bool done;
+		// set when the image is a baked KTX file, with all levels and faces of the texture
+		std::shared_ptr<KtxTexture> baked;
+
+		double decodeBegin, decodeEnd;
+		double uploadBegin, uploadEnd;
+		std::thread::id decodeThread;
+	};
+
+	struct StreamedTexture
+	{
+		unsigned int name;
+		bool cubemap;
+		bool srgb;
+		// level 0 allocated and the placeholder moved to the last level
+		bool allocated;
+		int imagesLeft;
+	};
+
+	ThreadPool* pool;
+	bool flipVertically;
+	// images and textures of the running stream, the decoder reads images without a lock, so neither changes until
+	// the stream ends
+	std::vector<Image> images;
+	std::vector<StreamedTexture> textures;
+	// queued for the next stream, Image::texture indexes queuedTextures until startStreaming() moves them over
+	std::vector<Image> queuedImages;
+	std::vector<StreamedTexture> queuedTextures;
+	// the images of the last finished stream, kept for the timeline
+	std::vector<Image> timeline;
+
+	// set by the decoder for each image once its data may be read on the GL thread
+	std::unique_ptr<std::atomic<bool>[]> decoded;
+	std::atomic<bool> cancelled;
+	std::thread decoder;
+	bool streaming;
+	size_t nextImage;
+	clock::time_point start;
+	double decodeTime, uploadTime;
+
+	unsigned int pbo;
+	int region;
+	GLsync fences[UPLOAD_REGIONS];
+
+	int addTexture(bool cubemap, bool srgb);
+	void addImage(const std::string& path, int texture, unsigned int target);
+	// queues the baked file of the texture if there is a usable one
+	bool addBaked(const std::string& path, int texture);
+	void decode(Image& image);
+	// false when there is no free region this frame
+	bool uploadRows(Image& image);
+	void allocate(StreamedTexture& texture, const Image& image);
+	void imageDone(Image& image);
+	void complete(StreamedTexture& texture);
+	void endStreaming();
+
+	TextureLoader(const TextureLoader&);
+	TextureLoader& operator=(const TextureLoader&);
+};
+
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Fork-join pool with work stealing. parallelFor splits the index range into chunks and hands every thread
+// (the caller included) a contiguous block of them. A thread works its own queue from the front, and once it is
+// empty steals from the back of the other queues, so an uneven split does not leave threads idle.
+// Which thread runs a chunk is not deterministic, callers must make chunks independent of each other.
+class ThreadPool
+{
+public:
+	// threadCount includes the calling thread, 1 runs everything on the caller
+	explicit ThreadPool(int threadCount);
+	~ThreadPool();
+
+	int getThreadCount() const { return (int)queues.size(); }
+	// chunks taken from another thread's queue since the pool was created
+	unsigned long long getStealCount() const { return steals.load(); }
+
+	// calls body(begin, end) for chunks of at most grain indices covering [0, count), returns when all are done.
+	// Calls from several threads are serialised, one job runs at a time; body must not call parallelFor itself.
+	void parallelFor(int count, int grain, const std::function<void(int, int)>& body);
+
+private:
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<std::pair<int, int> > ranges;
+	};
+
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<WorkQueue> > queues;
+
+	// held by parallelFor for the whole job, the body pointer and queue 0 belong to one caller at a time
+	std::mutex callMutex;
+	std::mutex jobMutex;
+	std::condition_variable jobReady;
+	unsigned long long jobGeneration;
+	bool stopping;
+
+	const std::function<void(int, int)>* body;
+	std::atomic<int> pendingRanges;
+	std::atomic<unsigned long long> steals;
+
+	void workerLoop(int index);
+	// runs one chunk from the own queue or a stolen one, false when there is nothing left
+	bool runOne(int index);
+
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+};
+
+#endif
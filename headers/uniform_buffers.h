@@ -0,0 +1,133 @@
+#pragma once
+
+#ifndef UNIFORM_BUFFERS_H
+#define UNIFORM_BUFFERS_H
+
+#include <glad/glad.h>
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// must match the defines at the top of shaders/*
+#define NR_POINT_LIGHTS 1
+#define NR_FLASHLIGHTS 1
+
+// fixed binding points of the shared uniform blocks
+#define FRAME_UBO_BINDING 0
+#define LIGHT_UBO_BINDING 1
+
+// std140 mirrors of the FrameData and LightData blocks declared in shaders/*.
+// vec3 members are followed by a float (or padding) so that every vec3 starts at a 16 byte boundary.
+
+struct FogStd140
+{
+	glm::vec3 color;
+	int isOn;
+	float expDensity;
+	float end;
+	float padding[2];
+};
+
+struct FrameUBO
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	FogStd140 fog;
+};
+
+struct DirLightStd140
+{
+	glm::vec3 direction;
+	float padding0;
+	glm::vec3 ambient;
+	float padding1;
+	glm::vec3 diffuse;
+	float padding2;
+	glm::vec3 specular;
+	float padding3;
+};
+
+struct PointLightStd140
+{
+	glm::vec3 position;
+	float constant;
+	glm::vec3 ambient;
+	float linear;
+	glm::vec3 diffuse;
+	float quadratic;
+	glm::vec3 specular;
+	float padding;
+};
+
+struct FlashlightStd140
+{
+	glm::vec3 position;
+	float constant;
+	glm::vec3 direction;
+	float linear;
+	glm::vec3 ambient;
+	float quadratic;
+	glm::vec3 diffuse;
+	float cutOff;
+	glm::vec3 specular;
+	float outerCutOff;
+};
+
+// all light positions and directions are in view space
+struct LightUBO
+{
+	DirLightStd140 dirLight;
+	PointLightStd140 pointLights[NR_POINT_LIGHTS];
+	FlashlightStd140 flashlights[NR_FLASHLIGHTS];
+};
+
+static_assert(sizeof(FogStd140) == 32, "FogStd140 does not match the std140 layout");
+static_assert(offsetof(FrameUBO, fog) == 128, "FrameUBO does not match the std140 layout");
+static_assert(sizeof(DirLightStd140) == 64, "DirLightStd140 does not match the std140 layout");
+static_assert(sizeof(PointLightStd140) == 64, "PointLightStd140 does not match the std140 layout");
+static_assert(sizeof(FlashlightStd140) == 80, "FlashlightStd140 does not match the std140 layout");
+
+// One buffer holding both blocks. The CPU copies are filled during the frame and
+// uploaded with a single glBufferSubData, after which every program reads the same data.
+class SceneUniformBuffer
+{
+public:
+	unsigned int ID;
+	FrameUBO frame;
+	LightUBO lights;
+
+	SceneUniformBuffer() : frame(), lights()
+	{
+		// the light block has to start at a multiple of the implementation's offset alignment
+		int alignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		lightOffset = (sizeof(FrameUBO) + alignment - 1) / alignment * alignment;
+		staging.resize(lightOffset + sizeof(LightUBO));
+
+		glGenBuffers(1, &ID);
+		glBindBuffer(GL_UNIFORM_BUFFER, ID);
+		glBufferData(GL_UNIFORM_BUFFER, staging.size(), NULL, GL_DYNAMIC_DRAW);
+		glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_UBO_BINDING, ID, 0, sizeof(FrameUBO));
+		glBindBufferRange(GL_UNIFORM_BUFFER, LIGHT_UBO_BINDING, ID, lightOffset, sizeof(LightUBO));
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	// copies frame and lights to the GPU, call once per frame before the first draw
+	void upload()
+	{
+		std::memcpy(&staging[0], &frame, sizeof(FrameUBO));
+		std::memcpy(&staging[lightOffset], &lights, sizeof(LightUBO));
+		glBindBuffer(GL_UNIFORM_BUFFER, ID);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, staging.size(), &staging[0]);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+private:
+	size_t lightOffset;
+	std::vector<unsigned char> staging;
+};
+
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+struct Vertex;
+
+// Layout of a mesh vertex in its VBO. Attribute locations stay the same in every layout:
+// 0 position, 1 normal, 2 uv, 3 tangent, 4 bitangent (full layout only), 5 bone ids, 6 bone weights.
+//
+// packed: normal and tangent as GL_INT_2_10_10_10_REV, the tangent w holds the bitangent sign, the shader rebuilds
+// it as cross(normal, tangent.xyz) * sign(tangent.w). UVs are half floats. Position stays 3 floats.
+// full: the 88 byte Vertex struct as it is in memory.
+struct VertexLayout
+{
+	bool packed;
+	bool tangents;
+	// set per mesh from the source data, meshes without bones get no bone attributes
+	bool bones;
+
+	VertexLayout() : packed(true), tangents(true), bones(false) {}
+
+	unsigned int stride() const;
+};
+
+// writes the vertices in the given layout
+void packVertices(const Vertex* vertices, size_t count, const VertexLayout& layout, std::vector<unsigned char>& out);
+
+// sets the attribute pointers for the bound VAO and VBO, attributes missing from the layout stay disabled
+void setVertexAttributes(const VertexLayout& layout);
+
+#endif
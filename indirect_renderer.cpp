@@ -0,0 +1,368 @@
+#include "headers/indirect_renderer.h"
+#include "headers/frame_stats.h"
+#include "headers/geometry_arena.h"
+#include "headers/gl_state.h"
+
+#include <algorithm>
+#include <cstring>
+
+static bool hasExtension(const char* extension)
+{
+	int count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (int i = 0; i < count; i++)
+	{
+		const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (name && std::strcmp(name, extension) == 0)
+			return true;
+	}
+	return false;
+}
+
+IndirectRenderer::IndirectRenderer(GLADloadproc loader) : multiDrawElementsIndirect(NULL), multiDraw(true), perVertexNormalMatrix(false),
+	frustumCulling(true), view(1.0f), viewProjection(1.0f), pendingShader(NULL), current(0), stateChanged(true), drawIndexCapacity(0)
+{
+	// the baseInstance of the commands has to reach the instanced attribute, which ARB_multi_draw_indirect alone does not promise
+	int major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	bool supported = major > 4 || (major == 4 && minor >= 3)
+		|| (hasExtension("GL_ARB_multi_draw_indirect") && hasExtension("GL_ARB_base_instance"));
+	if (supported && loader)
+		multiDrawElementsIndirect = (MultiDrawElementsIndirectProc)loader("glMultiDrawElementsIndirect");
+
+	int maxTexels = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+	maxStagedDraws = std::max(1u, (unsigned int)maxTexels / TEXELS_PER_DRAW);
+
+	glGenBuffers(1, &commandBuffer);
+	glGenBuffers(1, &drawIndexBuffer);
+	glGenBuffers(1, &dataBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, dataBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(IndirectDrawData), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	glGenTextures(1, &dataTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, dataTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, dataBuffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+IndirectRenderer::~IndirectRenderer()
+{
+	glDeleteTextures(1, &dataTexture);
+	glDeleteBuffers(1, &dataBuffer);
+	glDeleteBuffers(1, &drawIndexBuffer);
+	glDeleteBuffers(1, &commandBuffer);
+}
+
+// index of value in ids, appended when it is new
+template <typename T>
+static unsigned int findId(std::vector<T>& ids, const T& value)
+{
+	for (size_t i = 0; i < ids.size(); i++)
+		if (ids[i] == value)
+			return (unsigned int)i;
+	ids.push_back(value);
+	return (unsigned int)ids.size() - 1;
+}
+
+void IndirectRenderer::assignIds(Bucket& bucket)
+{
+	bucket.shaderId = findId(programIds, bucket.program);
+	bucket.materialId = findId(textureSetIds, bucket.textures);
+	bucket.vertexArrayId = findId(vertexArrayIds, bucket.vertexArray);
+}
+
+void IndirectRenderer::begin(const FrameState& frame)
+{
+	view = frame.view;
+	viewProjection = frame.viewProjection;
+	frustum = Frustum(frame.viewProjection);
+
+	size_t kept = 0;
+	for (size_t i = 0; i < buckets.size(); i++)
+	{
+		if (!buckets[i].used)
+			continue;
+		if (kept != i)
+			std::swap(buckets[kept], buckets[i]);
+		buckets[kept].used = false;
+		kept++;
+	}
+	buckets.resize(kept);
+
+	// ids of the states still in use only, textures evicted and loaded again come back under new names and their old
+	// sets would otherwise pile up until the ids no longer fit the keys
+	programIds.clear();
+	textureSetIds.clear();
+	vertexArrayIds.clear();
+	for (size_t i = 0; i < buckets.size(); i++)
+		assignIds(buckets[i]);
+
+	commands.clear();
+	commandBuckets.clear();
+	commandFirstDraws.clear();
+	commandFirstBoxes.clear();
+	draws.clear();
+	drawBounds.clear();
+	stateChanged = true;
+}
+
+void IndirectRenderer::setState(const Shader& shader, const GeometryArena& arena)
+{
+	pending.program = shader.ID;
+	pending.vertexArray = arena.getVertexArray();
+	pending.textures.clear();
+	pendingShader = &shader;
+	stateChanged = true;
+}
+
+void IndirectRenderer::setTexture(unsigned int unit, unsigned int target, unsigned int texture)
+{
+	BucketTexture binding = { unit, target, texture };
+	pending.textures.push_back(binding);
+	stateChanged = true;
+}
+
+void IndirectRenderer::add(const GeometryRange& range, const BoundingBox& bounds, const glm::mat4& model, const glm::vec4& material)
+{
+	addInstances(range, bounds, &model, &material, 1);
+}
+
+void IndirectRenderer::addInstances(const GeometryRange& range, const BoundingBox& bounds, const glm::mat4* models, const glm::vec4* materials,
+	unsigned int count)
+{
+	if (count == 0)
+		return;
+	if (stateChanged)
+	{
+		current = findBucket();
+		stateChanged = false;
+	}
+	buckets[current].used = true;
+
+	DrawElementsIndirectCommand command;
+	command.count = range.indexCount;
+	command.instanceCount = count;
+	command.firstIndex = range.firstIndex;
+	command.baseVertex = (int)range.firstVertex;
+	command.baseInstance = 0;
+	commands.push_back(command);
+	commandBuckets.push_back((unsigned int)current);
+	commandFirstDraws.push_back((unsigned int)draws.size());
+	commandFirstBoxes.push_back(frustumCulling ? (unsigned int)drawBounds.size() : NO_BOXES);
+
+	size_t first = draws.size();
+	draws.resize(first + count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		DrawTransforms transforms;
+		computeDrawTransforms(view, viewProjection, models[i], transforms);
+		IndirectDrawData& data = draws[first + i];
+		data.modelView = transforms.modelView;
+		for (int k = 0; k < 3; k++)
+			data.normalMatrix[k] = glm::vec4(transforms.normalMatrix[k], 0.0f);
+		data.material = materials ? materials[i] : glm::vec4(1.0f);
+		if (frustumCulling)
+			drawBounds.add(bounds.transformed(models[i]));
+	}
+}
+
+// The bucket of the pending state. The meshes of a model mostly share their state, so the bucket of the previous
+// draw is tried first.
+size_t IndirectRenderer::findBucket()
+{
+	for (size_t n = 0; n < buckets.size(); n++)
+	{
+		size_t i = (current + n) % buckets.size();
+		const Bucket& bucket = buckets[i];
+		if (bucket.program == pending.program && bucket.vertexArray == pending.vertexArray && bucket.textures == pending.textures)
+			return i;
+	}
+
+	Bucket bucket;
+	bucket.program = pending.program;
+	bucket.vertexArray = pending.vertexArray;
+	bucket.textures = pending.textures;
+	bucket.perVertexNormalMatrixLocation = pendingShader->getUniformLocation("perVertexNormalMatrix");
+	assignIds(bucket);
+	bucket.used = false;
+	buckets.push_back(bucket);
+	return buckets.size() - 1;
+}
+
+void IndirectRenderer::flush()
+{
+	// the draws without a box are all visible, the others as their box tests
+	unsigned int drawCount = 0, instances = 0, culled = 0;
+	visible.assign(draws.size(), 1);
+	if (drawBounds.size() > 0)
+	{
+		culled = (unsigned int)(drawBounds.size() - drawBounds.test(frustum, boxesVisible));
+		for (size_t i = 0; i < commands.size(); i++)
+		{
+			if (commandFirstBoxes[i] != NO_BOXES)
+				std::copy(boxesVisible.begin() + commandFirstBoxes[i], boxesVisible.begin() + commandFirstBoxes[i] + commands[i].instanceCount,
+					visible.begin() + commandFirstDraws[i]);
+		}
+	}
+
+	// a key for every command with a visible instance, at the depth of the nearest one
+	queue.clear();
+	for (size_t i = 0; i < commands.size(); i++)
+	{
+		bool anyVisible = false;
+		float nearest = 0.0f;
+		for (unsigned int k = 0, data = commandFirstDraws[i]; k < commands[i].instanceCount; k++, data++)
+		{
+			if (!visible[data])
+				continue;
+			float depth = -draws[data].modelView[3].z;
+			nearest = anyVisible ? std::min(nearest, depth) : depth;
+			anyVisible = true;
+		}
+		if (!anyVisible)
+			continue;
+		const Bucket& bucket = buckets[commandBuckets[i]];
+		queue.push(RenderQueue::makeKey(OPAQUE_PASS, bucket.shaderId, bucket.materialId, bucket.vertexArrayId, nearest), (unsigned int)i);
+	}
+	unsigned int addedOrderChanges = queue.countStateChanges();
+	queue.sort();
+	unsigned int stateChanges = queue.countStateChanges();
+
+	for (size_t q = 0; q < queue.size(); q++)
+	{
+		unsigned int i = queue.getItem(q);
+		size_t b = commandBuckets[i];
+		// the visible instances of a command are packed together, a new command starts when the upload is full
+		bool open = false;
+		for (unsigned int k = 0, data = commandFirstDraws[i]; k < commands[i].instanceCount; k++, data++)
+		{
+			if (!visible[data])
+				continue;
+			if (stagedDraws.size() == maxStagedDraws)
+			{
+				submitStaged();
+				open = false;
+			}
+			if (!open)
+			{
+				if (segments.empty() || segments.back().bucket != b)
+				{
+					Segment segment = { b, (unsigned int)stagedCommands.size(), 0 };
+					segments.push_back(segment);
+				}
+				// the index of the first instance's data, the attribute reads drawIndexBuffer[baseInstance + instance]
+				DrawElementsIndirectCommand command = commands[i];
+				command.instanceCount = 0;
+				command.baseInstance = (unsigned int)stagedDraws.size();
+				stagedCommands.push_back(command);
+				segments.back().commandCount++;
+				drawCount++;
+				open = true;
+			}
+			stagedCommands.back().instanceCount++;
+			stagedDraws.push_back(draws[data]);
+			instances++;
+		}
+	}
+	submitStaged();
+
+	frameStats.indirectDraws += drawCount;
+	frameStats.indirectInstances += instances;
+	frameStats.indirectBuckets += (unsigned int)buckets.size();
+	frameStats.multiDraw = usesMultiDraw();
+	frameStats.visibleDraws += instances;
+	frameStats.culledDraws += culled;
+	frameStats.frustumCulling = frameStats.frustumCulling || drawBounds.size() > 0;
+	frameStats.stateChanges += stateChanges;
+	frameStats.stateChangesAvoided += addedOrderChanges > stateChanges ? addedOrderChanges - stateChanges : 0;
+}
+
+// makes the draw index of the arena's vertex array, which is bound, an instanced attribute. Done once per vertex
+// array, the arenas outlive the renderer and keep their vertex arrays when they grow.
+void IndirectRenderer::prepareVertexArray(unsigned int vertexArray)
+{
+	if (std::find(preparedVertexArrays.begin(), preparedVertexArrays.end(), vertexArray) != preparedVertexArrays.end())
+		return;
+	glEnableVertexAttribArray(DRAW_INDEX_ATTRIBUTE);
+	glVertexAttribDivisor(DRAW_INDEX_ATTRIBUTE, 1);
+	preparedVertexArrays.push_back(vertexArray);
+}
+
+void IndirectRenderer::submitStaged()
+{
+	unsigned int count = (unsigned int)stagedDraws.size();
+	if (count == 0)
+		return;
+
+	if (count > drawIndexCapacity)
+	{
+		drawIndexCapacity = std::min(maxStagedDraws, std::max(count, 2 * drawIndexCapacity));
+		std::vector<unsigned int> indices(drawIndexCapacity);
+		for (unsigned int i = 0; i < drawIndexCapacity; i++)
+			indices[i] = i;
+		glBindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// glBufferData gives the buffers new storage, draws still reading the previous upload keep theirs
+	glBindBuffer(GL_TEXTURE_BUFFER, dataBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, (size_t)count * sizeof(IndirectDrawData), stagedDraws.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	glState.bindTexture(DRAW_DATA_UNIT, GL_TEXTURE_BUFFER, dataTexture);
+	frameStats.glCalls += 3;
+
+	bool multi = usesMultiDraw();
+	if (multi)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, stagedCommands.size() * sizeof(DrawElementsIndirectCommand), stagedCommands.data(), GL_STREAM_DRAW);
+		frameStats.glCalls += 2;
+	}
+
+	for (size_t s = 0; s < segments.size(); s++)
+	{
+		const Segment& segment = segments[s];
+		const Bucket& bucket = buckets[segment.bucket];
+		glState.useProgram(bucket.program);
+		for (size_t i = 0; i < bucket.textures.size(); i++)
+			glState.bindTexture(bucket.textures[i].unit, bucket.textures[i].target, bucket.textures[i].texture);
+		if (bucket.perVertexNormalMatrixLocation >= 0)
+		{
+			glUniform1i(bucket.perVertexNormalMatrixLocation, perVertexNormalMatrix);
+			frameStats.glCalls++;
+		}
+		glState.bindVertexArray(bucket.vertexArray);
+		prepareVertexArray(bucket.vertexArray);
+		glBindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer);
+		frameStats.glCalls++;
+
+		if (multi)
+		{
+			glVertexAttribIPointer(DRAW_INDEX_ATTRIBUTE, 1, GL_UNSIGNED_INT, 0, (void*)0);
+			multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)((size_t)segment.firstCommand * sizeof(DrawElementsIndirectCommand)),
+				(GLsizei)segment.commandCount, 0);
+			frameStats.glCalls += 2;
+			continue;
+		}
+
+		// fallback: GL 4.0 has no baseInstance, the attribute starts at the command's first instance instead
+		for (unsigned int i = segment.firstCommand; i < segment.firstCommand + segment.commandCount; i++)
+		{
+			const DrawElementsIndirectCommand& command = stagedCommands[i];
+			glVertexAttribIPointer(DRAW_INDEX_ATTRIBUTE, 1, GL_UNSIGNED_INT, 0, (void*)((size_t)command.baseInstance * sizeof(unsigned int)));
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+				(void*)((size_t)command.firstIndex * sizeof(unsigned int)), command.instanceCount, command.baseVertex);
+			frameStats.glCalls += 2;
+		}
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	if (multi)
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	stagedCommands.clear();
+	stagedDraws.clear();
+	segments.clear();
+}
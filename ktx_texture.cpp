@@ -0,0 +1,168 @@
+#include "headers/ktx_texture.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+static const unsigned char IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const uint32_t ENDIANNESS = 0x04030201;
+
+KtxTexture::KtxTexture() : header(NULL), dataSize(0)
+{
+}
+
+bool KtxTexture::open(const std::string& path)
+{
+	if (!file.open(path) || file.size() < sizeof(IDENTIFIER) + sizeof(Header)
+		|| std::memcmp(file.data(), IDENTIFIER, sizeof(IDENTIFIER)) != 0)
+	{
+		file.close();
+		return false;
+	}
+
+	header = (const Header*)(file.data() + sizeof(IDENTIFIER));
+	bool valid = header->endianness == ENDIANNESS && header->glType == 0 && header->glFormat == 0
+		&& header->pixelWidth > 0 && header->pixelHeight > 0 && header->pixelDepth == 0 && header->numberOfArrayElements == 0
+		&& (header->numberOfFaces == 1 || header->numberOfFaces == 6)
+		&& header->numberOfMipmapLevels > 0 && header->numberOfMipmapLevels <= 32;
+
+	size_t offset = sizeof(IDENTIFIER) + sizeof(Header) + (size_t)header->bytesOfKeyValueData;
+	levelOffsets.clear();
+	levelSizes.clear();
+	dataSize = 0;
+	for (uint32_t level = 0; valid && level < header->numberOfMipmapLevels; level++)
+	{
+		if (offset + sizeof(uint32_t) > file.size())
+		{
+			valid = false;
+			break;
+		}
+		uint32_t imageSize;
+		std::memcpy(&imageSize, file.data() + offset, sizeof(imageSize));
+		offset += sizeof(uint32_t);
+
+		// compressed images are multiples of 8 bytes, so there is no cube or mip padding
+		size_t levelSize = (size_t)imageSize * header->numberOfFaces;
+		valid = imageSize % 4 == 0 && offset + levelSize <= file.size();
+		levelOffsets.push_back(offset);
+		levelSizes.push_back(imageSize);
+		dataSize += levelSize;
+		offset += levelSize;
+	}
+
+	if (!valid)
+		file.close();
+	return valid;
+}
+
+void KtxTexture::touchPages() const
+{
+	volatile unsigned char sum = 0;
+	for (size_t offset = 0; offset < file.size(); offset += 4096)
+		sum += file.data()[offset];
+}
+
+void KtxTexture::upload(unsigned int texture, bool srgb) const
+{
+	GLenum bindTarget = getFaceCount() == 6 ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+	GLenum internalFormat = srgb && srgbFormat(getInternalFormat()) ? srgbFormat(getInternalFormat()) : getInternalFormat();
+	glBindTexture(bindTarget, texture);
+	for (int level = 0; level < getLevelCount(); level++)
+	{
+		int width = std::max(1, getWidth() >> level), height = std::max(1, getHeight() >> level);
+		for (int face = 0; face < getFaceCount(); face++)
+		{
+			GLenum target = bindTarget == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+			glCompressedTexImage2D(target, level, internalFormat, width, height, 0, getImageSize(level), getImage(level, face));
+		}
+	}
+	glTexParameteri(bindTarget, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(bindTarget, GL_TEXTURE_MAX_LEVEL, getLevelCount() - 1);
+}
+
+bool KtxTexture::write(const std::string& path, unsigned int internalFormat, unsigned int baseInternalFormat, int width, int height,
+	int faces, const std::vector<std::vector<unsigned char> >& images)
+{
+	Header fileHeader;
+	fileHeader.endianness = ENDIANNESS;
+	fileHeader.glType = 0;
+	fileHeader.glTypeSize = 1;
+	fileHeader.glFormat = 0;
+	fileHeader.glInternalFormat = internalFormat;
+	fileHeader.glBaseInternalFormat = baseInternalFormat;
+	fileHeader.pixelWidth = width;
+	fileHeader.pixelHeight = height;
+	fileHeader.pixelDepth = 0;
+	fileHeader.numberOfArrayElements = 0;
+	fileHeader.numberOfFaces = faces;
+	fileHeader.numberOfMipmapLevels = (uint32_t)(images.size() / faces);
+	fileHeader.bytesOfKeyValueData = 0;
+
+	std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+	if (!out)
+		return false;
+	out.write((const char*)IDENTIFIER, sizeof(IDENTIFIER));
+	out.write((const char*)&fileHeader, sizeof(fileHeader));
+	for (uint32_t level = 0; level < fileHeader.numberOfMipmapLevels; level++)
+	{
+		uint32_t imageSize = (uint32_t)images[level * faces].size();
+		out.write((const char*)&imageSize, sizeof(imageSize));
+		for (int face = 0; face < faces; face++)
+			out.write((const char*)images[level * faces + face].data(), imageSize);
+	}
+	return (bool)out;
+}
+
+static bool hasExtension(const char* extension)
+{
+	int count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (int i = 0; i < count; i++)
+	{
+		const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (name && std::strcmp(name, extension) == 0)
+			return true;
+	}
+	return false;
+}
+
+bool KtxTexture::isFormatSupported(unsigned int internalFormat)
+{
+	// RGTC (BC4, BC5) is core since GL 3.0, S3TC never became core and BPTC only in GL 4.2
+	switch (internalFormat)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		return hasExtension("GL_EXT_texture_compression_s3tc");
+	case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+		// the sRGB variants come with EXT_texture_sRGB, core profiles often list only the newer extension
+		return hasExtension("GL_EXT_texture_compression_s3tc")
+			&& (hasExtension("GL_EXT_texture_sRGB") || hasExtension("GL_EXT_texture_compression_s3tc_srgb"));
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+	case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+	{
+		int major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		return major > 4 || (major == 4 && minor >= 2) || hasExtension("GL_ARB_texture_compression_bptc");
+	}
+	default:
+		return internalFormat == GL_COMPRESSED_RG_RGTC2 || internalFormat == GL_COMPRESSED_RED_RGTC1;
+	}
+}
+
+unsigned int KtxTexture::srgbFormat(unsigned int internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		return GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+		return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+	default:
+		return 0;
+	}
+}
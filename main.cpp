@@ -5,20 +5,32 @@
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
 
-#include "headers/stb_image.h"
 #include "headers/shader.h"
 #include "headers/camera.h"
+#include "headers/camera_system.h"
 #include "headers/model.h"
 #include "headers/Sphere.h"
+#include "headers/flag.h"
+#include "headers/benchmarks.h"
+#include "headers/bvh.h"
+#include "headers/entity_store.h"
+#include "headers/frame_stats.h"
+#include "headers/gl_state.h"
+#include "headers/indirect_renderer.h"
+#include "headers/renderer.h"
+#include "headers/scene_graph.h"
+#include "headers/gpu_timer.h"
+#include "headers/texture_baker.h"
+#include "headers/texture_cache.h"
+#include "headers/texture_loader.h"
+#include "headers/thread_pool.h"
 
 #include <iostream>
-
-enum CameraType
-{
-	STATIC,
-	TRACKING,
-	FREE
-};
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <thread>
 
 enum PropertyModifyType
 {
@@ -35,39 +47,43 @@ enum TimeOfDay
 };
 
 void init_glfw();
+void renderScene(GLFWwindow* window);
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn);
-unsigned int loadTexture(const char* path);
-unsigned int loadCubemap(std::string path);
+void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
 void settingsKeyCallback(GLFWwindow* window, int key, int scancode, int action, int modes);
-void setLights(Shader shader);
-void setFog(Shader shader);
+void setLights(FrameState& state);
+void setFog(FrameState& state);
 void changeCameraType();
 void changeModifyType();
 void changeTimeOfDay();
-glm::mat4 GetViewMatrix();
-glm::mat4 GetProjectionMatrix();
+std::vector<Vertex> interleavedVertices(const float* data, unsigned int vertexCount, unsigned int floatsPerVertex);
+std::vector<unsigned int> sequentialIndices(unsigned int count);
+void placeContainers(const glm::vec3* positions, unsigned int positionCount, unsigned int stressCount,
+	EntityStore& entities, std::vector<Entity>& containers);
+std::string sceneObjectName(unsigned int object, unsigned int containerCount);
 float clamp(float n, float lower, float upper);
 
 // screen settings
 const unsigned int SCR_WIDTH = 1200;
 const unsigned int SCR_HEIGHT = 800;
 
-// camera settings
-CameraType activeCameraType = FREE;
+// camera settings (free, static, tracking), the aspect ratio follows the framebuffer size
+CameraSystem cameras(
+	Camera(glm::vec3(0.0f, 0.5f, 3.0f)),
+	Camera(3.0f, 4.5f, 4.0f, 0.0f, 0.0f, 0.0f),
+	Camera(glm::vec3(0.0f, 3.0f, 4.0f)),
+	SCR_WIDTH, SCR_HEIGHT);
 
 // free
-Camera freeCamera(glm::vec3(0.0f, 0.5f, 3.0f));
+Camera& freeCamera = cameras.Get(FREE);
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 
-// static
-Camera staticCamera(3.0f, 4.5f, 4.0f, 0.0f, 0.0f, 0.0f);
-
 // tracking
-Camera trackingCamera(glm::vec3(0.0f, 3.0f, 4.0f));
+Camera& trackingCamera = cameras.Get(TRACKING);
 
 // fog parameters
 bool fogOn = false;
@@ -86,11 +102,12 @@ glm::vec3 flashlightPos(0.0f, 0.0f, 0.0f);
 glm::vec3 flashlightStartDir(0.0f, 0.0f, 1.0f);
 glm::vec3 flashlightDir(0.0f, 0.0f, 0.0f);
 
-// object movement parameters
-const float RADIUS = 0.5f;
-const float CIRCURAL_SPEED = 1.0f;
-const float Y_POSITION = 0.25f;
-float theta = 0.0f;
+// flashlight cone, cosines computed once at startup
+const float FLASHLIGHT_CUT_OFF = glm::cos(glm::radians(12.5f));
+const float FLASHLIGHT_OUTER_CUT_OFF = glm::cos(glm::radians(17.5f));
+
+// moving container, circles the scene at this radius, height and speed (radians per second)
+const Animator CONTAINER_ORBIT = { 0.5f, 0.25f, 1.0f, 0.0f };
 
 // flag animation
 float windFreq = 2.0f;
@@ -104,6 +121,7 @@ float sphereShininess = 32.0f;
 // flag properties
 float flagSpecular = 0.5f;
 float flagShininess = 32.0f;
+FlagTessellation flagTessellation;
 
 // objects properties
 PropertyModifyType activeModifyType = SPHERE;
@@ -116,9 +134,110 @@ float windSpeedChangeSpeed = 0.2f;
 // time of the day
 TimeOfDay timeOfDay = DAY;
 
-int main()
+// benchmark mode (--benchmark [frames]), renders a fixed number of frames in a hidden window and reports the CPU frame time
+int benchmarkFrames = 0;
+
+// model load benchmark (--bench-model-load [path]), cold and warm start of the model cache in a hidden window
+const char* benchModelPath = NULL;
+
+// multi draw benchmark (--bench-indirect [objects]), CPU submission time of that many objects in a hidden window
+int benchIndirectObjects = 0;
+
+// container stress test (--stress-containers [count]), that many instanced containers instead of the ten of cubePositions
+unsigned int stressContainers = 0;
+
+// texture baking (--bake-textures [directory] [--bc7]), compresses the images and exits
+const char* bakeDirectory = NULL;
+bool bakeBC7 = false;
+
+// video memory the texture cache may keep unreferenced textures in (--texture-budget <MB>)
+size_t textureBudget = TextureCache::DEFAULT_BUDGET;
+
+// normal matrix comparison (V toggles per vertex inversion, T toggles the GPU timers of the opaque objects and flag draws)
+bool perVertexNormalMatrix = false;
+bool gpuTimersOn = false;
+
+// opaque objects drawn with one multi draw per bucket, or one draw at a time (I toggles, --no-multi-draw starts without)
+bool multiDraw = true;
+
+// objects outside the camera frustum are not drawn (K toggles, --no-culling starts without)
+bool frustumCulling = true;
+
+// the left mouse button picks the object in the middle of the free camera's view from the scene BVH
+bool pickRequested = false;
+
+int main(int argc, char* argv[])
 {
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--benchmark") == 0)
+		{
+			benchmarkFrames = 1000;
+			if (i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+				benchmarkFrames = std::atoi(argv[++i]);
+			gpuTimersOn = true;
+		}
+		else if (std::strcmp(argv[i], "--per-vertex-normals") == 0)
+			perVertexNormalMatrix = true;
+		else if (std::strcmp(argv[i], "--bench-cloth") == 0)
+			return runClothBenchmark();
+		else if (std::strcmp(argv[i], "--bench-bvh") == 0)
+			return runBvhBenchmark();
+		else if (std::strcmp(argv[i], "--check-bezier") == 0)
+			return runBezierCheck();
+		else if (std::strcmp(argv[i], "--bench-entities") == 0)
+		{
+			int count = 100000;
+			if (i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+				count = std::atoi(argv[++i]);
+			return runEntityBenchmark(count);
+		}
+		else if (std::strcmp(argv[i], "--bench-render-queue") == 0)
+		{
+			int count = 100000;
+			if (i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+				count = std::atoi(argv[++i]);
+			return runRenderQueueBenchmark(count);
+		}
+		else if (std::strcmp(argv[i], "--bench-model-load") == 0)
+		{
+			benchModelPath = "resources/backpack/backpack.obj";
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				benchModelPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--bench-indirect") == 0)
+		{
+			benchIndirectObjects = 10000;
+			if (i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+				benchIndirectObjects = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--stress-containers") == 0)
+		{
+			stressContainers = 100000;
+			if (i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+				stressContainers = (unsigned int)std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--no-multi-draw") == 0)
+			multiDraw = false;
+		else if (std::strcmp(argv[i], "--no-culling") == 0)
+			frustumCulling = false;
+		else if (std::strcmp(argv[i], "--bake-textures") == 0)
+		{
+			bakeDirectory = "resources/";
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				bakeDirectory = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--bc7") == 0)
+			bakeBC7 = true;
+		else if (std::strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+			textureBudget = (size_t)std::max(0, std::atoi(argv[++i])) * 1024 * 1024;
+	}
+	if (bakeDirectory)
+		return runTextureBaker(bakeDirectory, bakeBC7);
+
 	init_glfw();
+	if (benchmarkFrames > 0 || benchModelPath || benchIndirectObjects > 0)
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
 	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "OpenGL Scene Explorer", NULL, NULL);
 	if (window == NULL)
@@ -128,9 +247,15 @@ int main()
 		return -1;
 	}
 	glfwMakeContextCurrent(window);
+	if (benchmarkFrames > 0)
+		glfwSwapInterval(0);
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+	int framebufferWidth, framebufferHeight;
+	glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+	cameras.SetFramebufferSize(framebufferWidth, framebufferHeight);
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	glfwSetCursorPosCallback(window, mouse_callback);
+	glfwSetMouseButtonCallback(window, mouseButtonCallback);
 
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
 	{
@@ -138,14 +263,46 @@ int main()
 		return -1;
 	}
 
+	if (benchModelPath)
+	{
+		int result = runModelLoadBenchmark(benchModelPath);
+		geometryArenas.release();
+		glfwTerminate();
+		return result;
+	}
+
+	if (benchIndirectObjects > 0)
+	{
+		int result = runIndirectDrawBenchmark(benchIndirectObjects, (GLADloadproc)glfwGetProcAddress);
+		geometryArenas.release();
+		glfwTerminate();
+		return result;
+	}
+
 	glfwSetKeyCallback(window, settingsKeyCallback);
 
-	// Textures
-	unsigned int daySkyboxTexture = loadCubemap("resources/skyboxes/day/");
-	unsigned int nightSkyBoxTexture = loadCubemap("resources/skyboxes/night/");
-	unsigned int groundAlbedoMap = loadTexture("resources/ground/Ground037_4K-JPG_Color.jpg");
-	unsigned int boxDiffuseMap = loadTexture("resources/container/container2.png");
-	unsigned int boxSpecularMap = loadTexture("resources/container/container2_specular.png");
+	renderScene(window);
+
+	// the meshes of the scene are gone with it, the arenas go while the context is still there
+	geometryArenas.release();
+	glfwTerminate();
+	return 0;
+}
+
+// everything owning GL objects lives in this scope, so it is released while the context still exists
+void renderScene(GLFWwindow* window)
+{
+
+	// Textures, only queued here, they are decoded on the pool and streamed in while the first frames are rendered.
+	// The scene and the models share them through the cache, the scene keeps its references until it ends.
+	ThreadPool loadPool(std::max(1, (int)std::thread::hardware_concurrency()));
+	TextureLoader textureLoader(&loadPool);
+	TextureCache textureCache(&textureLoader, textureBudget);
+	unsigned int daySkyboxTexture = textureCache.acquireCubemap("resources/skyboxes/day/");
+	unsigned int nightSkyBoxTexture = textureCache.acquireCubemap("resources/skyboxes/night/");
+	unsigned int groundAlbedoMap = textureCache.acquire2D("resources/ground/Ground037_4K-JPG_Color.jpg");
+	unsigned int boxDiffuseMap = textureCache.acquire2D("resources/container/container2.png");
+	unsigned int boxSpecularMap = textureCache.acquire2D("resources/container/container2_specular.png");
 
 	float skyboxVertices[] = {
 
@@ -192,7 +349,7 @@ int main()
 		 1.0f, -1.0f,  1.0f
 	};
 
-	stbi_set_flip_vertically_on_load(true);
+	textureLoader.setFlipVertically(true);
 
 	glEnable(GL_DEPTH_TEST);
 
@@ -262,25 +419,6 @@ int main()
 	-10.0f, 0.0f,  10.0f,  0.0f,  1.0f, 0.0f,  0.0f,  10.0f,
 	};
 
-	float flagControlPoints[] = {
-		0.0f, 0.0f, 0.0f,
-		0.0f, 0.33f, 0.0f,
-		0.0f, 0.66f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		0.53f, 0.0f, 0.0f,
-		0.53f, 0.33f, 0.0f,
-		0.53f, 0.66f, 0.0f,
-		0.53f, 1.0f, 0.0f,
-		1.06f, 0.0f, 0.0f,
-		1.06f, 0.33f, 0.0f,
-		1.06f, 0.66f, 0.0f,
-		1.06f, 1.0f, 0.0f,
-		1.6f, 0.0f, 0.0f,
-		1.6f, 0.33f, 0.0f,
-		1.6f, 0.66f, 0.0f,
-		1.6f, 1.0f, 0.0f
-	};
-
 	unsigned int boxIndices[] = {
 		0, 1, 3,
 		1, 2, 3
@@ -295,91 +433,99 @@ int main()
 	Shader containerShader("shaders/container_shader.vs", "shaders/container_shader.fs");
 	Shader flagShader("shaders/flag_shader.vs", "shaders/flag_shader.fs", "shaders/flag_shader.tcs", "shaders/flag_shader.tes");
 
+	// shared uniform blocks
+	Shader* sceneShaders[] = { &lightingShader, &lightCubeShader, &skyboxShader, &floorShader, &sphereShader, &containerShader, &flagShader };
+	for (Shader* shader : sceneShaders)
+	{
+		shader->bindUniformBlock("FrameData", FRAME_UBO_BINDING);
+		shader->bindUniformBlock("LightData", LIGHT_UBO_BINDING);
+	}
+	Renderer renderer;
+	// container, backpack, sphere and floor, their vertex shaders read the transforms from its draw data
+	IndirectRenderer opaqueDraws((GLADloadproc)glfwGetProcAddress);
+	std::cout << "opaque objects: multi draw " << (opaqueDraws.isMultiDrawSupported() ? "supported" : "not supported, drawn one at a time") << std::endl;
+	Shader* opaqueShaders[] = { &lightingShader, &floorShader, &sphereShader, &containerShader };
+	for (Shader* shader : opaqueShaders)
+	{
+		shader->use();
+		shader->setInt("drawData", IndirectRenderer::DRAW_DATA_UNIT);
+	}
+
 	//Objects
-	Model backpackModel("resources/backpack/backpack.obj");
+	// shader.vs has no normal mapping, so the backpack does not need tangents in its vertex buffer.
+	// nothing reads its vertices on the CPU, so they are dropped once uploaded.
+	VertexLayout backpackLayout;
+	backpackLayout.tangents = false;
+	Model backpackModel("resources/backpack/backpack.obj", false, backpackLayout, &textureCache, GEOMETRY_DROP);
 	Sphere sphere;
 
-	// box VAO
-	unsigned int boxVAO, boxVBO;
-	glGenVertexArrays(1, &boxVAO);
-	glGenBuffers(1, &boxVBO);
-	glBindVertexArray(boxVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, boxVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(boxVertices), boxVertices, GL_STATIC_DRAW);
-
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-
-	// light VAO
-	unsigned int lightCubeVAO, lightCubeVBO;
-	glGenVertexArrays(1, &lightCubeVAO);
-	glGenBuffers(1, &lightCubeVBO);
-	glBindVertexArray(lightCubeVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, lightCubeVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(boxVertices), boxVertices, GL_STATIC_DRAW);
-
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	// flag VAO
-	unsigned int flagVAO, flagVBO;
-	glGenVertexArrays(1, &flagVAO);
-	glGenBuffers(1, &flagVBO);
-	glBindVertexArray(flagVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, flagVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(flagControlPoints), flagControlPoints, GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	// floor VAO
-	unsigned int floorVAO, floorVBO;
-	glGenVertexArrays(1, &floorVAO);
-	glGenBuffers(1, &floorVBO);
-	glBindVertexArray(floorVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, floorVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(floorVertices), floorVertices, GL_STATIC_DRAW);
-
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-
-	// skybox VAO
-	unsigned int skyboxVAO, skyboxVBO;
-	glGenVertexArrays(1, &skyboxVAO);
-	glGenBuffers(1, &skyboxVBO);
-	glBindVertexArray(skyboxVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-
-	// sphere VAO
-	unsigned int sphereVAO, sphereVBO, sphereEBO;
-	glGenVertexArrays(1, &sphereVAO);
-	glBindVertexArray(sphereVAO);
-	glGenBuffers(1, &sphereVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
-	glBufferData(GL_ARRAY_BUFFER, sphere.getInterleavedVertexSize(), sphere.getInterleavedVertices(), GL_STATIC_DRAW);
-	glGenBuffers(1, &sphereEBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sphere.getIndexSize(), sphere.getIndices(), GL_STATIC_DRAW);
-
-	int sphereDataStride = sphere.getInterleavedStride();
-	glVertexAttribPointer(0, 3, GL_FLOAT, false, sphereDataStride, (void*)0);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, false, sphereDataStride, (void*)(sizeof(float) * 3));
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(2, 2, GL_FLOAT, false, sphereDataStride, (void*)(sizeof(float) * 6));
-	glEnableVertexAttribArray(2);
-
-	glBindVertexArray(0);
+	// flag, 4 x 3 patches over the area of the old single patch, simulated as cloth on the CPU
+	Flag flag(4, 3, 1.6f, 1.0f);
+
+	// static scene geometry, in the backpack's layout so it shares the backpack's arena: one vertex array for all of
+	// it, and the flat shaded objects are drawn indexed like the meshes
+	GeometryArena& sceneArena = geometryArenas.get(backpackLayout);
+	std::vector<unsigned int> cubeIndices = sequentialIndices(36);
+	std::vector<Vertex> boxMesh = interleavedVertices(boxVertices, 36, 8);
+	GeometryRange boxGeometry = sceneArena.add(boxMesh.data(), 36, cubeIndices.data(), 36);
+	std::vector<Vertex> floorMesh = interleavedVertices(floorVertices, 6, 8);
+	GeometryRange floorGeometry = sceneArena.add(floorMesh.data(), 6, cubeIndices.data(), 6);
+	std::vector<Vertex> skyboxMesh = interleavedVertices(skyboxVertices, 36, 3);
+	GeometryRange skyboxGeometry = sceneArena.add(skyboxMesh.data(), 36, cubeIndices.data(), 36);
+	std::vector<Vertex> sphereMesh = interleavedVertices(sphere.getInterleavedVertices(), sphere.getInterleavedVertexCount(),
+		sphere.getInterleavedStride() / sizeof(float));
+	GeometryRange sphereGeometry = sceneArena.add(sphereMesh.data(), sphere.getInterleavedVertexCount(), sphere.getIndices(), sphere.getIndexCount());
+	// model space boxes for frustum culling, the meshes of the models compute theirs when they are created
+	BoundingBox boxBounds = BoundingBox::fromPositions(boxMesh.data(), sizeof(Vertex), 36);
+	BoundingBox floorBounds = BoundingBox::fromPositions(floorMesh.data(), sizeof(Vertex), 6);
+	BoundingBox sphereBounds = BoundingBox::fromPositions(sphereMesh.data(), sizeof(Vertex), sphere.getInterleavedVertexCount());
+	geometryArenas.printStats(std::cout);
+
+	// Entities of the containers, drawn as instances of the box (mesh 0) in a single command: the static ones and the
+	// moving one, which circles the scene carrying the flashlight. Their systems run every frame, the model matrices
+	// of the static containers are only computed once.
+	EntityStore entities;
+	std::vector<Entity> containers;
+	placeContainers(cubePositions, sizeof(cubePositions) / sizeof(cubePositions[0]), stressContainers, entities, containers);
+	Entity movingContainer = entities.create(TRANSFORM_COMPONENT | MESH_COMPONENT | MATERIAL_COMPONENT | LIGHT_COMPONENT | ANIMATOR_COMPONENT);
+	entities.animator(movingContainer) = CONTAINER_ORBIT;
+	entities.transform(movingContainer).scale = glm::vec3(0.5f);
+	entities.animate(0.0f);
+	entities.updateTransforms();
+	DrawList containerDraws;
+
+	// Scene graph of the objects that stay in place, their world matrices are computed once. The nodes of the
+	// backpack's file hang below the backpack.
+	SceneGraph sceneGraph;
+	unsigned int backpackNode = sceneGraph.add(glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(-2.0f, 0.4f, 0.0f)), glm::vec3(0.2f)));
+	std::vector<unsigned int> backpackNodes;
+	backpackModel.addToScene(sceneGraph, backpackNode, backpackNodes);
+	unsigned int sphereNode = sceneGraph.add(glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 0.25f, 0.0f)), glm::vec3(0.25f)));
+	unsigned int floorNode = sceneGraph.add(glm::mat4(1.0f));
+	unsigned int flagNode = sceneGraph.add(glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -2.0f)), glm::vec3(0.8f)));
+	sceneGraph.update();
+
+	// Scene BVH over the world space boxes of the objects: the moving container, the static containers and then the
+	// backpack, sphere, floor and flag. It culls them before they are submitted and answers the picking rays; the
+	// moving container and the flag are refitted every frame.
+	const unsigned int containerCount = (unsigned int)containers.size();
+	const unsigned int sceneBackpack = containerCount + 1, sceneSphere = containerCount + 2, sceneFloor = containerCount + 3,
+		sceneFlag = containerCount + 4;
+	std::vector<BoundingBox> sceneBoxes;
+	sceneBoxes.reserve(sceneFlag + 1);
+	sceneBoxes.push_back(boxBounds.transformed(entities.world(movingContainer)));
+	for (unsigned int i = 0; i < containerCount; i++)
+		sceneBoxes.push_back(boxBounds.transformed(entities.world(containers[i])));
+	sceneBoxes.push_back(backpackModel.getBounds().transformed(sceneGraph.getWorld(backpackNode)));
+	sceneBoxes.push_back(sphereBounds.transformed(sceneGraph.getWorld(sphereNode)));
+	sceneBoxes.push_back(floorBounds.transformed(sceneGraph.getWorld(floorNode)));
+	sceneBoxes.push_back(flag.getBounds().transformed(sceneGraph.getWorld(flagNode)));
+	Bvh sceneBvh;
+	double bvhStart = glfwGetTime();
+	sceneBvh.build(sceneBoxes.data(), (unsigned int)sceneBoxes.size());
+	std::cout << "scene bvh: " << sceneBvh.getObjectCount() << " objects, " << sceneBvh.getNodeCount() << " nodes, built in "
+		<< (glfwGetTime() - bvhStart) * 1000.0 << " ms" << std::endl;
+	std::vector<unsigned int> sceneVisible;
 
 	floorShader.use();
 	floorShader.setInt("albedoMap", 0);
@@ -391,6 +537,38 @@ int main()
 	containerShader.setInt("material.diffuse", 0);
 	containerShader.setInt("material.specular", 1);
 
+	// uniform locations used in the render loop
+	TransformLocations flagTransformLocs(flagShader);
+	GpuTimer opaqueTimer, flagTimer;
+	int containerShininessLoc = containerShader.getUniformLocation("material.shininess");
+	int sphereAmbientLoc = sphereShader.getUniformLocation("material.ambient");
+	int sphereSpecularLoc = sphereShader.getUniformLocation("material.specular");
+	int sphereDiffuseLoc = sphereShader.getUniformLocation("material.diffuse");
+	int sphereShininessLoc = sphereShader.getUniformLocation("material.shininess");
+	int sphereColorLoc = sphereShader.getUniformLocation("material.Color");
+	int flagAmbientLoc = flagShader.getUniformLocation("material.ambient");
+	int flagSpecularLoc = flagShader.getUniformLocation("material.specular");
+	int flagDiffuseLoc = flagShader.getUniformLocation("material.diffuse");
+	int flagShininessLoc = flagShader.getUniformLocation("material.shininess");
+	int flagColorLoc = flagShader.getUniformLocation("material.Color");
+	flagTessellation.resolveLocations(flagShader);
+
+	float lastStatsTime = 0.0f;
+	int renderedFrames = 0;
+	double cpuTimeSum = 0.0, cpuTimeMin = 1e9, cpuTimeMax = 0.0;
+	double opaqueGpuTimeSum = 0.0, flagGpuTimeSum = 0.0;
+
+	// every texture of the scene is queued by now, the benchmark waits for all of them so every frame costs the same
+	if (benchmarkFrames > 0)
+	{
+		textureLoader.finish();
+		textureLoader.printTimeline(std::cout);
+		textureCache.trim();
+		textureCache.printReport(std::cout);
+	}
+	else
+		textureLoader.startStreaming();
+
 	// render loop
 	while (!glfwWindowShouldClose(window))
 	{
@@ -398,150 +576,244 @@ int main()
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
+		// print the counters of the previous frame once per second
+		if (benchmarkFrames == 0 && currentFrame - lastStatsTime >= 1.0f)
+		{
+			frameStats.print(std::cout);
+			lastStatsTime = currentFrame;
+		}
+		frameStats.reset();
+
 		// update kamery ledzcej poruszajcy si obiekt
-		theta += CIRCURAL_SPEED * deltaTime;
-		float new_x = RADIUS * cos(theta), new_z = RADIUS * sin(theta);
-		trackingCamera.UpdateTarget(glm::vec3(new_x, Y_POSITION, new_z));
+		entities.animate(deltaTime);
+		trackingCamera.UpdateTarget(entities.transform(movingContainer).position);
 
 		// input
 		processInput(window);
 
+		// cloth simulation of the flag, the old shader wind is the flutter now
+		ClothWind wind;
+		wind.direction = glm::vec3(1.0f, 0.0f, 0.0f);
+		wind.strength = 25.0f;
+		wind.flutter = windAmp * 20.0f;
+		wind.freq = windFreq;
+		wind.speed = windSpeed;
+		double clothStart = glfwGetTime();
+		frameStats.clothSteps = flag.update(deltaTime, wind);
+		frameStats.clothTime = (float)((glfwGetTime() - clothStart) * 1000.0);
+
+		// textures still streaming in, at most one upload region per frame
+		if (textureLoader.isStreaming())
+		{
+			double uploadStart = glfwGetTime();
+			textureLoader.update();
+			frameStats.texturesStreaming = true;
+			frameStats.textureUploadTime = (float)((glfwGetTime() - uploadStart) * 1000.0);
+			if (!textureLoader.isStreaming())
+			{
+				textureLoader.printTimeline(std::cout);
+				textureCache.trim();
+				textureCache.printReport(std::cout);
+			}
+		}
+
 		// render commands
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		// the flashlight is attached to the moving container, the arrow keys turn it in the container's space
+		entities.light(movingContainer).direction = flashlightStartDir;
+		entities.updateTransforms();
+		entities.updateLights();
+		flashlightDir = entities.light(movingContainer).worldDirection;
+		flashlightPos = entities.light(movingContainer).worldPosition;
+		frameStats.sceneNodes = (unsigned int)sceneGraph.size();
+		frameStats.sceneNodesUpdated = sceneGraph.update();
+		sceneBvh.update(0, boxBounds.transformed(entities.world(movingContainer)));
+		// the cloth moves inside the flag's node every frame
+		sceneBvh.update(sceneFlag, flag.getBounds().transformed(sceneGraph.getWorld(flagNode)));
+
+		if (pickRequested)
+		{
+			float distance;
+			int picked = sceneBvh.intersectRay(freeCamera.Position, freeCamera.Front, 100.0f, distance);
+			if (picked >= 0)
+				std::cout << "pick: " << sceneObjectName((unsigned int)picked, containerCount) << " at " << distance << std::endl;
+			else
+				std::cout << "pick: nothing" << std::endl;
+			pickRequested = false;
+		}
+
+		// camera, lights and fog shared by every program
+		FrameState frameState;
+		frameState.view = cameras.GetViewMatrix();
+		frameState.projection = cameras.GetProjectionMatrix();
+		frameState.viewProjection = cameras.GetViewProjectionMatrix();
+		frameState.cameraPosition = cameras.GetPosition();
+		frameState.viewportSize = glm::vec2((float)cameras.GetFramebufferWidth(), (float)cameras.GetFramebufferHeight());
+		frameState.time = currentFrame;
+		setLights(frameState);
+		setFog(frameState);
+		renderer.setPerVertexNormalMatrix(perVertexNormalMatrix);
+		renderer.beginFrame(frameState);
+
+		// objects in view by the scene BVH, the containers among them gathered for the instanced command; without
+		// culling the draw list holds every entity with a mesh
+		bool backpackVisible = true, sphereVisible = true, floorVisible = true, flagVisible = true;
+		containerDraws.clear();
+		if (frustumCulling)
+		{
+			backpackVisible = sphereVisible = floorVisible = flagVisible = false;
+			sceneVisible.clear();
+			sceneBvh.cull(Frustum(frameState.viewProjection), sceneVisible);
+			for (unsigned int object : sceneVisible)
+			{
+				if (object <= containerCount)
+				{
+					Entity container = object == 0 ? movingContainer : containers[object - 1];
+					containerDraws.add(entities.mesh(container).mesh, entities.world(container), entities.material(container).parameters);
+				}
+				else if (object == sceneBackpack)
+					backpackVisible = true;
+				else if (object == sceneSphere)
+					sphereVisible = true;
+				else if (object == sceneFloor)
+					floorVisible = true;
+				else if (object == sceneFlag)
+					flagVisible = true;
+			}
+			frameStats.sceneCulling = true;
+			frameStats.visibleSceneObjects = (unsigned int)sceneVisible.size();
+			frameStats.culledSceneObjects = sceneBvh.getObjectCount() - (unsigned int)sceneVisible.size();
+		}
+		else
+			entities.buildDrawList(containerDraws);
+
+		// opaque objects, collected into buckets of equal state and drawn together after the floor, sorted by state and
+		// front to back; the flag and the skybox follow them
+		opaqueDraws.setMultiDraw(multiDraw);
+		opaqueDraws.setPerVertexNormalMatrix(perVertexNormalMatrix);
+		// the BVH above culled the objects as a whole, the renderer's per draw test only runs for the meshes of the
+		// backpack, which may be partly in view
+		opaqueDraws.setFrustumCulling(false);
+		opaqueDraws.begin(frameState);
+
 		// container
-		containerShader.use();
-		glm::mat4 model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(new_x, Y_POSITION, new_z));
-		model = glm::rotate(model, (-1) * atan2(new_z, new_x), glm::vec3(0.0f, 1.0f, 0.0f));
-		model = glm::scale(model, glm::vec3(0.5f));
-		flashlightDir = glm::vec3(model * glm::vec4(glm::normalize(flashlightStartDir), 0.0f));
-		flashlightPos = glm::vec3(new_x, Y_POSITION, new_z);
-		setLights(containerShader);
-		setFog(containerShader);
-		containerShader.setMat4("model", model);
-		glm::mat4 projection = GetProjectionMatrix();
-		glm::mat4 view = GetViewMatrix();
-		containerShader.setMat4("projection", projection);
-		containerShader.setMat4("view", view);
-		containerShader.setFloat("material.shininess", 64.0f);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, boxDiffuseMap);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, boxSpecularMap);
-		glBindVertexArray(boxVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+		renderer.useShader(containerShader);
+		containerShader.setFloat(containerShininessLoc, 64.0f);
+		opaqueDraws.setState(containerShader, sceneArena);
+		opaqueDraws.setTexture(0, GL_TEXTURE_2D, boxDiffuseMap);
+		opaqueDraws.setTexture(1, GL_TEXTURE_2D, boxSpecularMap);
+		if (containerDraws.getInstanceCount(0) > 0)
+			opaqueDraws.addInstances(boxGeometry, boxBounds, containerDraws.models[0].data(), containerDraws.materials[0].data(),
+				containerDraws.getInstanceCount(0));
 
 		// plecak
-		lightingShader.use();
-		setLights(lightingShader);
-		setFog(lightingShader);
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(-2.0f, 0.4f, 0.0f));
-		model = glm::scale(model, glm::vec3(0.2f));
-		lightingShader.setMat4("model", model);
-		projection = GetProjectionMatrix();
-		view = GetViewMatrix();
-		lightingShader.setMat4("projection", projection);
-		lightingShader.setMat4("view", view);
-		backpackModel.Draw(lightingShader);
+		renderer.useShader(lightingShader);
+		opaqueDraws.setFrustumCulling(frustumCulling);
+		if (backpackVisible)
+			backpackModel.Submit(lightingShader, opaqueDraws, sceneGraph, backpackNodes);
+		opaqueDraws.setFrustumCulling(false);
 
 		// rysowanie sfery
-		sphereShader.use();
-		setFog(sphereShader);
-		setLights(sphereShader);
-		projection = GetProjectionMatrix();
-		view = GetViewMatrix();
-		sphereShader.setMat4("projection", projection);
-		sphereShader.setMat4("view", view);
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(2.0f, 0.25f, 0.0f));
-		model = glm::scale(model, glm::vec3(0.25f));
-		sphereShader.setMat4("model", model);;
-		sphereShader.setFloat("material.ambient", 0.1f);
-		sphereShader.setFloat("material.specular", sphereSpecular);
-		sphereShader.setFloat("material.diffuse", 0.6f);
-		sphereShader.setFloat("material.shininess", sphereShininess);
-		sphereShader.setVec3("material.Color", glm::vec3(0.5f, 1.0f, 0.0f));
-		glBindVertexArray(sphereVAO);
-		glDrawElements(GL_TRIANGLES, sphere.getIndexCount(), GL_UNSIGNED_INT, 0);
-
-		// flaga
-		flagShader.use();
-		setFog(flagShader);
-		setLights(flagShader);
-		projection = GetProjectionMatrix();
-		view = GetViewMatrix();
-		flagShader.setMat4("projection", projection);
-		flagShader.setMat4("view", view);
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(0.0f, 0.0f, -2.0f));
-		model = glm::scale(model, glm::vec3(0.8f));
-		flagShader.setMat4("model", model);
-		// material
-		flagShader.setFloat("material.ambient", 0.1f);
-		flagShader.setFloat("material.specular", flagSpecular);
-		flagShader.setFloat("material.diffuse", 0.6f);
-		flagShader.setFloat("material.shininess", flagShininess);
-		flagShader.setVec3("material.Color", glm::vec3(1.0f, 0.0f, 0.0f));
-		// wind
-		flagShader.setFloat("wind.speed", windSpeed);
-		flagShader.setFloat("wind.amp", windAmp);
-		flagShader.setFloat("wind.freq", windFreq);
-		flagShader.setFloat("time", float(glfwGetTime()));
-
-		glBindVertexArray(flagVAO);
-		glPatchParameteri(GL_PATCH_VERTICES, 16);
-		glDrawArrays(GL_PATCHES, 0, 16);
+		renderer.useShader(sphereShader);
+		sphereShader.setFloat(sphereAmbientLoc, 0.1f);
+		sphereShader.setFloat(sphereSpecularLoc, sphereSpecular);
+		sphereShader.setFloat(sphereDiffuseLoc, 0.6f);
+		sphereShader.setFloat(sphereShininessLoc, sphereShininess);
+		sphereShader.setVec3(sphereColorLoc, glm::vec3(0.5f, 1.0f, 0.0f));
+		opaqueDraws.setState(sphereShader, sceneArena);
+		if (sphereVisible)
+			opaqueDraws.add(sphereGeometry, sphereBounds, sceneGraph.getWorld(sphereNode));
 
 		// podoe
-		floorShader.use();
-		setLights(floorShader);
-		setFog(floorShader);
-		projection = GetProjectionMatrix();
-		view = GetViewMatrix();
-		floorShader.setMat4("projection", projection);
-		floorShader.setMat4("view", view);
-
-		glBindVertexArray(floorVAO);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, groundAlbedoMap);
-		model = glm::mat4(1.0f);
-		floorShader.setMat4("model", model);
-		glDrawArrays(GL_TRIANGLES, 0, 6);
+		opaqueDraws.setState(floorShader, sceneArena);
+		opaqueDraws.setTexture(0, GL_TEXTURE_2D, groundAlbedoMap);
+		if (floorVisible)
+			opaqueDraws.add(floorGeometry, floorBounds, sceneGraph.getWorld(floorNode));
+
+		if (gpuTimersOn)
+			opaqueTimer.begin();
+		unsigned int glCallsBefore = frameStats.glCalls;
+		opaqueDraws.flush();
+		frameStats.opaqueGlCalls = frameStats.glCalls - glCallsBefore;
+		if (gpuTimersOn)
+			opaqueTimer.end();
+
+		// flaga, culled by the scene BVH with the box of its control points
+		if (flagVisible)
+		{
+			renderer.useShader(flagShader);
+			renderer.setTransforms(flagShader, flagTransformLocs, sceneGraph.getWorld(flagNode));
+			// material
+			flagShader.setFloat(flagAmbientLoc, 0.1f);
+			flagShader.setFloat(flagSpecularLoc, flagSpecular);
+			flagShader.setFloat(flagDiffuseLoc, 0.6f);
+			flagShader.setFloat(flagShininessLoc, flagShininess);
+			flagShader.setVec3(flagColorLoc, glm::vec3(1.0f, 0.0f, 0.0f));
+			flagTessellation.setUniforms(flagShader, frameState.viewportSize.y);
+			if (gpuTimersOn)
+				flagTimer.begin();
+			flag.draw();
+			if (gpuTimersOn)
+				flagTimer.end();
+		}
 
 		// skybox
 		glDepthFunc(GL_LEQUAL);
-		skyboxShader.use();
-		view = glm::mat4(glm::mat3(GetViewMatrix()));
-		skyboxShader.setMat4("view", view);
-		skyboxShader.setMat4("projection", projection);
-		glBindVertexArray(skyboxVAO);
-		glActiveTexture(GL_TEXTURE0);
+		renderer.useShader(skyboxShader);
 		switch (timeOfDay)
 		{
 		case DAY:
 		{
-			glBindTexture(GL_TEXTURE_CUBE_MAP, daySkyboxTexture);
+			glState.bindTexture(0, GL_TEXTURE_CUBE_MAP, daySkyboxTexture);
 			break;
 		}
 		case NIGHT:
 		{
-			glBindTexture(GL_TEXTURE_CUBE_MAP, nightSkyBoxTexture);
+			glState.bindTexture(0, GL_TEXTURE_CUBE_MAP, nightSkyBoxTexture);
 			break;
 		}
 		}
 
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-		glBindVertexArray(0);
+		sceneArena.draw(skyboxGeometry);
 		glDepthFunc(GL_LESS);
 
+		// CPU time spent on the frame, without waiting for the swap
+		double cpuTime = (glfwGetTime() - currentFrame) * 1000.0;
+		frameStats.cpuFrameTime = (float)cpuTime;
+		frameStats.gpuTimersOn = gpuTimersOn;
+		frameStats.perVertexNormalMatrix = perVertexNormalMatrix;
+		frameStats.opaqueGpuTime = opaqueTimer.lastTime();
+		frameStats.flagGpuTime = flagTimer.lastTime();
+
 		glfwSwapBuffers(window);
 		glfwPollEvents();
+
+		if (benchmarkFrames > 0)
+		{
+			cpuTimeSum += cpuTime;
+			cpuTimeMin = std::min(cpuTimeMin, cpuTime);
+			cpuTimeMax = std::max(cpuTimeMax, cpuTime);
+			opaqueGpuTimeSum += opaqueTimer.lastTime();
+			flagGpuTimeSum += flagTimer.lastTime();
+			if (++renderedFrames >= benchmarkFrames)
+				break;
+		}
+	}
+
+	if (benchmarkFrames > 0 && renderedFrames > 0)
+	{
+		std::cout << "benchmark: " << renderedFrames << " frames on " << glGetString(GL_RENDERER) << std::endl;
+		std::cout << "CPU frame time: avg " << cpuTimeSum / renderedFrames << " ms, min " << cpuTimeMin
+			<< " ms, max " << cpuTimeMax << " ms" << std::endl;
+		if (stressContainers > 0)
+			std::cout << "containers: " << containers.size() << " instances per frame, "
+				<< containers.size() * renderedFrames / (cpuTimeSum / 1000.0) / 1e6 << " million per CPU second" << std::endl;
+		std::cout << "GPU time (normal matrix " << (perVertexNormalMatrix ? "per vertex" : "from CPU") << "): opaque avg "
+			<< opaqueGpuTimeSum / renderedFrames << " ms, flag avg " << flagGpuTimeSum / renderedFrames << " ms" << std::endl;
+		frameStats.print(std::cout);
 	}
 
-	glfwTerminate();
-	return 0;
 }
 
 void init_glfw()
@@ -555,6 +827,7 @@ void init_glfw()
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
 	glViewport(0, 0, width, height);
+	cameras.SetFramebufferSize(width, height);
 }
 
 void processInput(GLFWwindow* window)
@@ -562,7 +835,7 @@ void processInput(GLFWwindow* window)
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
 
-	if (activeCameraType == FREE)
+	if (cameras.GetActiveType() == FREE)
 	{
 		if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
 			freeCamera.ProcessKeyboard(FORWARD, deltaTime);
@@ -698,7 +971,7 @@ void processInput(GLFWwindow* window)
 
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 {
-	if (activeCameraType == FREE)
+	if (cameras.GetActiveType() == FREE)
 	{
 		float xpos = static_cast<float>(xposIn);
 		float ypos = static_cast<float>(yposIn);
@@ -720,82 +993,10 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 	}
 }
 
-unsigned int loadTexture(char const* path)
-{
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-
-	int width, height, nrComponents;
-	unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-	if (data)
-	{
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
-	}
-
-	return textureID;
-}
-
-unsigned int loadCubemap(std::string path)
+void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
 {
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-	vector<std::string> faces{
-		"right.jpg",
-			"left.jpg",
-			"top.jpg",
-			"bottom.jpg",
-			"front.jpg",
-			"back.jpg"
-	};
-
-	int width, height, nrChannels;
-	for (unsigned int i = 0; i < faces.size(); i++)
-	{
-		unsigned char* data = stbi_load((path + faces[i]).c_str(), &width, &height, &nrChannels, 0);
-		if (data)
-		{
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-				0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data
-			);
-			stbi_image_free(data);
-		}
-		else
-		{
-			std::cout << "Cubemap tex failed to load at path: " << faces[i] << std::endl;
-			stbi_image_free(data);
-		}
-	}
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-	return textureID;
+	if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
+		pickRequested = true;
 }
 
 void settingsKeyCallback(GLFWwindow* window, int key, int scancode, int action, int modes)
@@ -808,6 +1009,14 @@ void settingsKeyCallback(GLFWwindow* window, int key, int scancode, int action,
 		changeModifyType();
 	if (key == GLFW_KEY_P && action == GLFW_PRESS)
 		changeTimeOfDay();
+	if (key == GLFW_KEY_V && action == GLFW_PRESS)
+		perVertexNormalMatrix = !perVertexNormalMatrix;
+	if (key == GLFW_KEY_T && action == GLFW_PRESS)
+		gpuTimersOn = !gpuTimersOn;
+	if (key == GLFW_KEY_I && action == GLFW_PRESS)
+		multiDraw = !multiDraw;
+	if (key == GLFW_KEY_K && action == GLFW_PRESS)
+		frustumCulling = !frustumCulling;
 	if (activeModifyType == SPOTLIGHT && key == GLFW_KEY_N && action == GLFW_PRESS)
 	{
 		flashlightStartDir.z *= -1;
@@ -816,62 +1025,65 @@ void settingsKeyCallback(GLFWwindow* window, int key, int scancode, int action,
 		
 }
 
-void setLights(Shader shader)
+void setLights(FrameState& state)
 {
 	// point light 1
-	shader.setVec3("lightPos[0]", lightPos);
-	shader.setVec3("pointLights[0].ambient", glm::vec3(0.2f, 0.2f, 0.2f));
-	shader.setVec3("pointLights[0].diffuse", glm::vec3(0.5f, 0.5f, 0.5f));
-	shader.setVec3("pointLights[0].specular", glm::vec3(1.0f, 1.0f, 1.0f));
-	shader.setFloat("pointLights[0].constant", 1.0f);
-	shader.setFloat("pointLights[0].linear", 0.07f);
-	shader.setFloat("pointLights[0].quadratic", 0.017f);
+	PointLightState& pointLight = state.pointLights[0];
+	pointLight.position = lightPos;
+	pointLight.ambient = glm::vec3(0.2f, 0.2f, 0.2f);
+	pointLight.diffuse = glm::vec3(0.5f, 0.5f, 0.5f);
+	pointLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+	pointLight.constant = 1.0f;
+	pointLight.linear = 0.07f;
+	pointLight.quadratic = 0.017f;
 	// directional light
-	shader.setVec3("dirLightDirection", sunPos);
+	DirLightState& dirLight = state.dirLight;
+	dirLight.direction = sunPos;
 	switch (timeOfDay)
 	{
 	case DAY:
 	{
-		shader.setVec3("dirLight.ambient", glm::vec3(0.3f, 0.3f, 0.4f));
-		shader.setVec3("dirLight.diffuse", glm::vec3(0.8f, 0.8f, 0.7f));
-		shader.setVec3("dirLight.specular", glm::vec3(1.0f, 1.0f, 0.9f));
+		dirLight.ambient = glm::vec3(0.3f, 0.3f, 0.4f);
+		dirLight.diffuse = glm::vec3(0.8f, 0.8f, 0.7f);
+		dirLight.specular = glm::vec3(1.0f, 1.0f, 0.9f);
 		break;
 	}	
 	case NIGHT:
 	{
-		shader.setVec3("dirLight.ambient", glm::vec3(0.05f, 0.05f, 0.1f));
-		shader.setVec3("dirLight.diffuse", glm::vec3(0.1f, 0.1f, 0.2f));
-		shader.setVec3("dirLight.specular", glm::vec3(0.2f, 0.2f, 0.3f));
+		dirLight.ambient = glm::vec3(0.05f, 0.05f, 0.1f);
+		dirLight.diffuse = glm::vec3(0.1f, 0.1f, 0.2f);
+		dirLight.specular = glm::vec3(0.2f, 0.2f, 0.3f);
 		break;
 	}
 	}
 	
 	// flashlight
-	shader.setVec3("flashlightPos[0]", flashlightPos);
-	shader.setVec3("flashlightDir[0]", flashlightDir);
-	shader.setFloat("flashlights[0].constant", 1.0f);
-	shader.setFloat("flashlights[0].linear", 0.035f);
-	shader.setFloat("flashlights[0].quadratic", 0.44f);
-	shader.setFloat("flashlights[0].cutOff", glm::cos(glm::radians(12.5f)));
-	shader.setVec3("flashlights[0].ambient", glm::vec3(0.1f, 0.1f, 0.1f));
-	shader.setVec3("flashlights[0].diffuse", glm::vec3(0.8f, 0.8f, 0.8f));
-	shader.setVec3("flashlights[0].specular", glm::vec3(1.0f, 1.0f, 1.0f));
-	shader.setFloat("flashlights[0].outerCutOff", glm::cos(glm::radians(17.5f)));
+	FlashlightState& flashlight = state.flashlights[0];
+	flashlight.position = flashlightPos;
+	flashlight.direction = flashlightDir;
+	flashlight.constant = 1.0f;
+	flashlight.linear = 0.035f;
+	flashlight.quadratic = 0.44f;
+	flashlight.cutOff = FLASHLIGHT_CUT_OFF;
+	flashlight.ambient = glm::vec3(0.1f, 0.1f, 0.1f);
+	flashlight.diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+	flashlight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+	flashlight.outerCutOff = FLASHLIGHT_OUTER_CUT_OFF;
 }
 
-void setFog(Shader shader)
+void setFog(FrameState& state)
 {
-	shader.setBool("fog.IsOn", fogOn);
-	shader.setFloat("fog.ExpDensity", fogExpDensity);
-	shader.setFloat("fog.End", fogEnd);
-	shader.setVec3("fog.Color", fogColor);
+	state.fog.isOn = fogOn;
+	state.fog.expDensity = fogExpDensity;
+	state.fog.end = fogEnd;
+	state.fog.color = fogColor;
 }
 
 void changeCameraType()
 {
-	int aCTint = static_cast<int>(activeCameraType);
+	int aCTint = static_cast<int>(cameras.GetActiveType());
 	aCTint = (aCTint + 1) % 3;
-	activeCameraType = static_cast<CameraType>(aCTint);
+	cameras.SetActive(static_cast<CameraType>(aCTint));
 	firstMouse = true;
 }
 
@@ -889,45 +1101,71 @@ void changeTimeOfDay()
 	timeOfDay = static_cast<TimeOfDay>(tODint);
 }
 
-glm::mat4 GetViewMatrix()
+float clamp(float n, float lower, float upper)
 {
-	switch (activeCameraType)
-	{
-	case FREE:
-	{
-		return freeCamera.GetViewMatrix();
-	}
-	case STATIC:
-	{
-		return staticCamera.GetViewMatrix();
-	}
-	case TRACKING:
-	{
-		return trackingCamera.GetViewMatrix();
-	}
-	}
+	return max(lower, min(n, upper));
 }
 
-glm::mat4 GetProjectionMatrix()
+// vertices from interleaved floats: a position, then a normal and uv when there are 8 floats per vertex
+std::vector<Vertex> interleavedVertices(const float* data, unsigned int vertexCount, unsigned int floatsPerVertex)
 {
-	switch (activeCameraType)
+	std::vector<Vertex> vertices(vertexCount, Vertex());
+	for (unsigned int i = 0; i < vertexCount; i++, data += floatsPerVertex)
 	{
-	case FREE:
-	{
-		return glm::perspective(glm::radians(freeCamera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-	}
-	case STATIC:
-	{
-		return glm::perspective(glm::radians(staticCamera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+		vertices[i].Position = glm::vec3(data[0], data[1], data[2]);
+		if (floatsPerVertex >= 8)
+		{
+			vertices[i].Normal = glm::vec3(data[3], data[4], data[5]);
+			vertices[i].TexCoords = glm::vec2(data[6], data[7]);
+		}
 	}
-	case TRACKING:
+	return vertices;
+}
+
+// indices of unindexed triangles, for drawing them from the arena
+std::vector<unsigned int> sequentialIndices(unsigned int count)
+{
+	std::vector<unsigned int> indices(count);
+	for (unsigned int i = 0; i < count; i++)
+		indices[i] = i;
+	return indices;
+}
+
+// Entities of the instanced containers: the positions raised above the floor and turned like in the original scene,
+// or with stressCount > 0 that many in a cubic grid behind the scene. The materials tint the diffuse map and scale
+// the shininess, so neighbours differ.
+void placeContainers(const glm::vec3* positions, unsigned int positionCount, unsigned int stressCount,
+	EntityStore& entities, std::vector<Entity>& containers)
+{
+	const unsigned int components = TRANSFORM_COMPONENT | MESH_COMPONENT | MATERIAL_COMPONENT;
+	unsigned int count = stressCount > 0 ? stressCount : positionCount;
+	unsigned int side = (unsigned int)std::ceil(std::cbrt((double)count));
+	entities.reserve(components, count);
+	containers.resize(count);
+	for (unsigned int i = 0; i < count; i++)
 	{
-		return glm::perspective(glm::radians(trackingCamera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-	}
+		glm::vec3 position;
+		if (stressCount > 0)
+			position = glm::vec3(1.5f * ((float)(i % side) - side / 2.0f), 1.0f + 1.5f * (float)(i / side % side),
+				-12.0f - 1.5f * (float)(i / (side * side)));
+		else
+			position = positions[i] + glm::vec3(0.0f, 3.0f, -3.0f);
+		containers[i] = entities.create(components);
+		Transform& transform = entities.transform(containers[i]);
+		transform.position = position;
+		transform.rotation = glm::angleAxis(glm::radians(20.0f * (float)i), glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f)));
+		entities.material(containers[i]).parameters = glm::vec4(0.6f + 0.4f * (float)(i % 3) / 2.0f, 0.6f + 0.4f * (float)(i % 5) / 4.0f,
+			0.6f + 0.4f * (float)(i % 7) / 6.0f, 0.25f + 0.25f * (float)(i % 4));
 	}
 }
 
-float clamp(float n, float lower, float upper)
+// name of an object of the scene BVH, for the picking output
+std::string sceneObjectName(unsigned int object, unsigned int containerCount)
 {
-	return max(lower, min(n, upper));
-}
\ No newline at end of file
+	if (object == 0)
+		return "moving container";
+	if (object <= containerCount)
+		return "container " + std::to_string(object - 1);
+	static const char* const names[] = { "backpack", "sphere", "floor", "flag" };
+	return names[object - containerCount - 1];
+}
@@ -0,0 +1,213 @@
+#include "headers/model_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+static const char MAGIC[4] = { 'G', 'K', 'M', 'C' };
+static const size_t BLOB_ALIGNMENT = 16;
+
+static uint32_t layoutFlags(const VertexLayout& layout)
+{
+	return (layout.packed ? 1u : 0u) | (layout.tangents ? 2u : 0u);
+}
+
+static uint64_t alignUp(uint64_t value)
+{
+	return (value + BLOB_ALIGNMENT - 1) & ~(uint64_t)(BLOB_ALIGNMENT - 1);
+}
+
+bool ModelCache::hashFile(const std::string& path, uint64_t& hash)
+{
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if (!in)
+		return false;
+
+	hash = 14695981039346656037ULL;
+	char buffer[1 << 16];
+	while (in)
+	{
+		in.read(buffer, sizeof(buffer));
+		std::streamsize count = in.gcount();
+		for (std::streamsize i = 0; i < count; i++)
+		{
+			hash ^= (unsigned char)buffer[i];
+			hash *= 1099511628211ULL;
+		}
+	}
+	return true;
+}
+
+// length bytes from offset lie inside a file of size bytes, the offsets come from the file and their sums could wrap
+static bool rangeInside(uint64_t offset, uint64_t length, uint64_t size)
+{
+	return offset <= size && length <= size - offset;
+}
+
+ModelCache::ModelCache() : header(NULL), meshes(NULL), textures(NULL), nodes(NULL), dependencies(NULL), strings(NULL)
+{
+}
+
+bool ModelCache::open(const std::string& path, uint64_t sourceHash, const VertexLayout& layout)
+{
+	if (!file.open(path) || file.size() < sizeof(ModelCacheHeader))
+		return false;
+
+	const unsigned char* data = file.data();
+	uint64_t size = file.size();
+	header = (const ModelCacheHeader*)data;
+	if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION
+		|| header->sourceHash != sourceHash || header->layoutFlags != layoutFlags(layout))
+	{
+		file.close();
+		return false;
+	}
+
+	// every table and blob has to lie inside the file, a truncated cache is treated as stale
+	uint64_t tables = sizeof(ModelCacheHeader) + (uint64_t)header->meshCount * sizeof(ModelCacheMesh)
+		+ (uint64_t)header->textureCount * sizeof(ModelCacheTexture) + (uint64_t)header->nodeCount * sizeof(ModelNode)
+		+ (uint64_t)header->dependencyCount * sizeof(ModelCacheDependency);
+	bool valid = tables <= header->stringTableOffset && header->stringTableSize > 0
+		&& rangeInside(header->stringTableOffset, header->stringTableSize, size)
+		&& data[header->stringTableOffset + header->stringTableSize - 1] == '\0';
+
+	meshes = (const ModelCacheMesh*)(data + sizeof(ModelCacheHeader));
+	textures = (const ModelCacheTexture*)(meshes + header->meshCount);
+	nodes = (const ModelNode*)(textures + header->textureCount);
+	dependencies = (const ModelCacheDependency*)(nodes + header->nodeCount);
+	strings = (const char*)(data + header->stringTableOffset);
+
+	for (unsigned int i = 0; valid && i < header->meshCount; i++)
+	{
+		const ModelCacheMesh& mesh = meshes[i];
+		VertexLayout meshLayout = layout;
+		meshLayout.bones = mesh.bones != 0;
+		valid = rangeInside(mesh.vertexOffset, (uint64_t)mesh.vertexCount * meshLayout.stride(), size)
+			&& rangeInside(mesh.indexOffset, (uint64_t)mesh.indexCount * sizeof(unsigned int), size)
+			&& (uint64_t)mesh.firstTexture + mesh.textureCount <= header->textureCount;
+	}
+	for (unsigned int i = 0; valid && i < header->textureCount; i++)
+		valid = textures[i].type < header->stringTableSize && textures[i].path < header->stringTableSize;
+	for (unsigned int i = 0; valid && i < header->nodeCount; i++)
+		valid = nodes[i].parent < (int32_t)i && (uint64_t)nodes[i].firstMesh + nodes[i].meshCount <= header->meshCount;
+	// an edited material library changes the textures of the meshes, the cache is then as stale as after editing the model
+	for (unsigned int i = 0; valid && i < header->dependencyCount; i++)
+	{
+		uint64_t hash = 0;
+		valid = dependencies[i].path < header->stringTableSize && hashFile(strings + dependencies[i].path, hash)
+			&& hash == dependencies[i].hash;
+	}
+
+	if (!valid)
+		file.close();
+	return valid;
+}
+
+bool ModelCache::write(const std::string& path, uint64_t sourceHash, const VertexLayout& layout, const std::vector<Mesh>& meshList,
+	const std::vector<ModelNode>& nodeList, const std::vector<std::string>& dependencyPaths)
+{
+	ModelCacheHeader fileHeader;
+	std::memcpy(fileHeader.magic, MAGIC, sizeof(MAGIC));
+	fileHeader.version = VERSION;
+	fileHeader.sourceHash = sourceHash;
+	fileHeader.layoutFlags = layoutFlags(layout);
+	fileHeader.meshCount = (uint32_t)meshList.size();
+	fileHeader.nodeCount = (uint32_t)nodeList.size();
+	fileHeader.dependencyCount = (uint32_t)dependencyPaths.size();
+
+	// material table and string table
+	std::vector<ModelCacheTexture> textureList;
+	std::string stringTable;
+	for (size_t i = 0; i < meshList.size(); i++)
+	{
+		for (size_t t = 0; t < meshList[i].textures.size(); t++)
+		{
+			ModelCacheTexture texture;
+			texture.type = (uint32_t)stringTable.size();
+			stringTable.append(meshList[i].textures[t].type).push_back('\0');
+			texture.path = (uint32_t)stringTable.size();
+			stringTable.append(meshList[i].textures[t].path).push_back('\0');
+			textureList.push_back(texture);
+		}
+	}
+	std::vector<ModelCacheDependency> dependencyList(dependencyPaths.size());
+	for (size_t i = 0; i < dependencyPaths.size(); i++)
+	{
+		if (!hashFile(dependencyPaths[i], dependencyList[i].hash))
+			return false;
+		dependencyList[i].path = (uint32_t)stringTable.size();
+		dependencyList[i].padding = 0;
+		stringTable.append(dependencyPaths[i]).push_back('\0');
+	}
+	if (stringTable.empty())
+		stringTable.push_back('\0');
+	fileHeader.textureCount = (uint32_t)textureList.size();
+	fileHeader.stringTableSize = (uint32_t)stringTable.size();
+	fileHeader.stringTableOffset = sizeof(ModelCacheHeader) + meshList.size() * sizeof(ModelCacheMesh)
+		+ textureList.size() * sizeof(ModelCacheTexture) + nodeList.size() * sizeof(ModelNode)
+		+ dependencyList.size() * sizeof(ModelCacheDependency);
+
+	// blobs after the string table, vertices are packed here the same way Mesh uploads them
+	std::vector<ModelCacheMesh> records(meshList.size());
+	std::vector<std::vector<unsigned char> > vertexBlobs(meshList.size());
+	uint64_t offset = fileHeader.stringTableOffset + fileHeader.stringTableSize;
+	uint32_t firstTexture = 0;
+	for (size_t i = 0; i < meshList.size(); i++)
+	{
+		const Mesh& mesh = meshList[i];
+		packVertices(mesh.vertices.data(), mesh.vertices.size(), mesh.layout, vertexBlobs[i]);
+
+		ModelCacheMesh& record = records[i];
+		record.vertexCount = (uint32_t)mesh.vertices.size();
+		record.indexCount = (uint32_t)mesh.indices.size();
+		record.bones = mesh.layout.bones ? 1 : 0;
+		record.firstTexture = firstTexture;
+		record.textureCount = (uint32_t)mesh.textures.size();
+		record.padding = 0;
+		firstTexture += record.textureCount;
+
+		record.vertexOffset = alignUp(offset);
+		offset = record.vertexOffset + vertexBlobs[i].size();
+		record.indexOffset = alignUp(offset);
+		offset = record.indexOffset + mesh.indices.size() * sizeof(unsigned int);
+	}
+
+	// written under a temporary name first, so an interrupted write never leaves a cache that looks valid
+	std::string temporaryPath = path + ".tmp";
+	{
+		std::ofstream out(temporaryPath.c_str(), std::ios::binary | std::ios::trunc);
+		if (!out)
+			return false;
+
+		out.write((const char*)&fileHeader, sizeof(fileHeader));
+		if (!records.empty())
+			out.write((const char*)&records[0], records.size() * sizeof(ModelCacheMesh));
+		if (!textureList.empty())
+			out.write((const char*)&textureList[0], textureList.size() * sizeof(ModelCacheTexture));
+		if (!nodeList.empty())
+			out.write((const char*)&nodeList[0], nodeList.size() * sizeof(ModelNode));
+		if (!dependencyList.empty())
+			out.write((const char*)&dependencyList[0], dependencyList.size() * sizeof(ModelCacheDependency));
+		out.write(stringTable.data(), stringTable.size());
+
+		const char zeros[BLOB_ALIGNMENT] = {};
+		uint64_t written = fileHeader.stringTableOffset + fileHeader.stringTableSize;
+		for (size_t i = 0; i < meshList.size(); i++)
+		{
+			out.write(zeros, records[i].vertexOffset - written);
+			if (!vertexBlobs[i].empty())
+				out.write((const char*)&vertexBlobs[i][0], vertexBlobs[i].size());
+			written = records[i].vertexOffset + vertexBlobs[i].size();
+
+			out.write(zeros, records[i].indexOffset - written);
+			if (!meshList[i].indices.empty())
+				out.write((const char*)&meshList[i].indices[0], meshList[i].indices.size() * sizeof(unsigned int));
+			written = records[i].indexOffset + meshList[i].indices.size() * sizeof(unsigned int);
+		}
+		if (!out)
+			return false;
+	}
+
+	std::remove(path.c_str());
+	return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+}
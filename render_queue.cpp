@@ -0,0 +1,98 @@
+#include "headers/render_queue.h"
+
+#include <cstring>
+
+static const unsigned int STATE_BITS = RenderQueue::SHADER_BITS + RenderQueue::MATERIAL_BITS + RenderQueue::VERTEX_ARRAY_BITS;
+static const uint64_t STATE_MASK = (1ULL << STATE_BITS) - 1;
+static const unsigned int DEPTH_BITS = 31;
+static const uint64_t DEPTH_MASK = (1ULL << DEPTH_BITS) - 1;
+
+// The bits of a positive float grow with its value, so the depth sorts as an integer without being quantized. The
+// sign bit is 0, which leaves 31 bits.
+static uint64_t depthBits(float depth)
+{
+	if (!(depth > 0.0f))
+		return 0;
+	uint32_t bits;
+	std::memcpy(&bits, &depth, sizeof(bits));
+	return bits;
+}
+
+uint64_t RenderQueue::makeKey(RenderPass pass, unsigned int shader, unsigned int material, unsigned int vertexArray, float depth)
+{
+	uint64_t state = ((uint64_t)(shader & ((1u << SHADER_BITS) - 1)) << (MATERIAL_BITS + VERTEX_ARRAY_BITS))
+		| ((uint64_t)(material & ((1u << MATERIAL_BITS) - 1)) << VERTEX_ARRAY_BITS)
+		| (uint64_t)(vertexArray & ((1u << VERTEX_ARRAY_BITS) - 1));
+	uint64_t key = (uint64_t)pass << 62;
+	if (pass == TRANSPARENT_PASS)
+		return key | ((DEPTH_MASK - depthBits(depth)) << STATE_BITS) | state;
+	return key | (state << 32) | depthBits(depth);
+}
+
+unsigned int RenderQueue::getState(uint64_t key)
+{
+	if (getPass(key) == TRANSPARENT_PASS)
+		return (unsigned int)(key & STATE_MASK);
+	return (unsigned int)((key >> 32) & STATE_MASK);
+}
+
+void RenderQueue::push(uint64_t key, unsigned int item)
+{
+	Entry entry = { key, item };
+	entries.push_back(entry);
+}
+
+void RenderQueue::sort()
+{
+	size_t count = entries.size();
+	if (count < 2)
+		return;
+
+	// the histograms of all eight bytes in one pass over the keys
+	std::vector<size_t> counts(8 * 256, 0);
+	for (size_t i = 0; i < count; i++)
+	{
+		uint64_t key = entries[i].key;
+		for (unsigned int byte = 0; byte < 8; byte++)
+			counts[byte * 256 + ((key >> (8 * byte)) & 0xff)]++;
+	}
+
+	scratch.resize(count);
+	for (unsigned int byte = 0; byte < 8; byte++)
+	{
+		size_t* histogram = &counts[byte * 256];
+		if (histogram[(entries[0].key >> (8 * byte)) & 0xff] == count)
+			continue;
+		size_t offset = 0;
+		for (unsigned int digit = 0; digit < 256; digit++)
+		{
+			size_t digitCount = histogram[digit];
+			histogram[digit] = offset;
+			offset += digitCount;
+		}
+		for (size_t i = 0; i < count; i++)
+			scratch[histogram[(entries[i].key >> (8 * byte)) & 0xff]++] = entries[i];
+		entries.swap(scratch);
+	}
+}
+
+unsigned int RenderQueue::countStateChanges() const
+{
+	unsigned int changes = 0;
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		unsigned int state = getState(entries[i].key);
+		if (i == 0)
+		{
+			changes += 3;
+			continue;
+		}
+		unsigned int previous = getState(entries[i - 1].key);
+		unsigned int shader = state >> (MATERIAL_BITS + VERTEX_ARRAY_BITS), previousShader = previous >> (MATERIAL_BITS + VERTEX_ARRAY_BITS);
+		unsigned int material = (state >> VERTEX_ARRAY_BITS) & ((1u << MATERIAL_BITS) - 1);
+		unsigned int previousMaterial = (previous >> VERTEX_ARRAY_BITS) & ((1u << MATERIAL_BITS) - 1);
+		unsigned int vertexArray = state & ((1u << VERTEX_ARRAY_BITS) - 1), previousVertexArray = previous & ((1u << VERTEX_ARRAY_BITS) - 1);
+		changes += (shader != previousShader) + (material != previousMaterial) + (vertexArray != previousVertexArray);
+	}
+	return changes;
+}
@@ -0,0 +1,131 @@
+#include "headers/renderer.h"
+#include "headers/gl_state.h"
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+#include "glm/simd/matrix.h"
+#endif
+
+TransformLocations::TransformLocations() : modelView(-1), mvp(-1), normalMatrix(-1), perVertexNormalMatrix(-1)
+{
+}
+
+TransformLocations::TransformLocations(const Shader& shader)
+{
+	modelView = shader.getUniformLocation("modelView");
+	mvp = shader.getUniformLocation("mvp");
+	normalMatrix = shader.getUniformLocation("normalMatrix");
+	perVertexNormalMatrix = shader.getUniformLocation("perVertexNormalMatrix");
+}
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+// glm::mat4 is not guaranteed to be 16 byte aligned, so the columns are moved with unaligned loads and stores
+static void multiplySSE(const glm::mat4& a, const glm::mat4& b, glm::mat4& out)
+{
+	glm_vec4 lhs[4], rhs[4], result[4];
+	for (int i = 0; i < 4; i++)
+	{
+		lhs[i] = _mm_loadu_ps(&a[i][0]);
+		rhs[i] = _mm_loadu_ps(&b[i][0]);
+	}
+	glm_mat4_mul(lhs, rhs, result);
+	for (int i = 0; i < 4; i++)
+		_mm_storeu_ps(&out[i][0], result[i]);
+}
+#endif
+
+void computeDrawTransforms(const glm::mat4& view, const glm::mat4& viewProjection, const glm::mat4& model, DrawTransforms& out)
+{
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+	multiplySSE(view, model, out.modelView);
+	multiplySSE(viewProjection, model, out.mvp);
+#else
+	out.modelView = view * model;
+	out.mvp = viewProjection * model;
+#endif
+
+	// inverse transpose of the upper 3x3 from its cofactors, the translation does not affect normals
+	glm::vec3 c0 = glm::vec3(out.modelView[0]);
+	glm::vec3 c1 = glm::vec3(out.modelView[1]);
+	glm::vec3 c2 = glm::vec3(out.modelView[2]);
+	glm::vec3 r0 = glm::cross(c1, c2);
+	float invDet = 1.0f / glm::dot(c0, r0);
+	out.normalMatrix = glm::mat3(r0 * invDet, glm::cross(c2, c0) * invDet, glm::cross(c0, c1) * invDet);
+}
+
+Renderer::Renderer() : state(), perVertexNormalMatrix(false)
+{
+}
+
+void Renderer::beginFrame(const FrameState& frameState)
+{
+	state = frameState;
+
+	FrameUBO& frame = uniforms.frame;
+	frame.view = state.view;
+	frame.projection = state.projection;
+	frame.fog.isOn = state.fog.isOn;
+	frame.fog.expDensity = state.fog.expDensity;
+	frame.fog.end = state.fog.end;
+	frame.fog.color = state.fog.color;
+
+	// the shaders light in view space, so positions and directions are transformed here once per frame
+	glm::mat3 viewRotation = glm::mat3(state.view);
+	LightUBO& lights = uniforms.lights;
+
+	lights.dirLight.direction = viewRotation * state.dirLight.direction;
+	lights.dirLight.ambient = state.dirLight.ambient;
+	lights.dirLight.diffuse = state.dirLight.diffuse;
+	lights.dirLight.specular = state.dirLight.specular;
+
+	for (int i = 0; i < NR_POINT_LIGHTS; i++)
+	{
+		const PointLightState& source = state.pointLights[i];
+		PointLightStd140& target = lights.pointLights[i];
+		target.position = glm::vec3(state.view * glm::vec4(source.position, 1.0f));
+		target.ambient = source.ambient;
+		target.diffuse = source.diffuse;
+		target.specular = source.specular;
+		target.constant = source.constant;
+		target.linear = source.linear;
+		target.quadratic = source.quadratic;
+	}
+
+	for (int i = 0; i < NR_FLASHLIGHTS; i++)
+	{
+		const FlashlightState& source = state.flashlights[i];
+		FlashlightStd140& target = lights.flashlights[i];
+		target.position = glm::vec3(state.view * glm::vec4(source.position, 1.0f));
+		target.direction = glm::normalize(viewRotation * source.direction);
+		target.ambient = source.ambient;
+		target.diffuse = source.diffuse;
+		target.specular = source.specular;
+		target.constant = source.constant;
+		target.linear = source.linear;
+		target.quadratic = source.quadratic;
+		target.cutOff = source.cutOff;
+		target.outerCutOff = source.outerCutOff;
+	}
+
+	uniforms.upload();
+	// whatever ran since the last frame may have bound other objects
+	glState.invalidate();
+}
+
+void Renderer::useShader(const Shader& shader)
+{
+	glState.useProgram(shader.ID);
+}
+
+void Renderer::setTransforms(const Shader& shader, const TransformLocations& locations, const glm::mat4& model) const
+{
+	DrawTransforms transforms;
+	computeDrawTransforms(state.view, state.viewProjection, model, transforms);
+
+	shader.setMat4(locations.mvp, transforms.mvp);
+	if (locations.modelView >= 0)
+		shader.setMat4(locations.modelView, transforms.modelView);
+	if (locations.normalMatrix >= 0)
+		shader.setMat3(locations.normalMatrix, transforms.normalMatrix);
+	if (locations.perVertexNormalMatrix >= 0)
+		shader.setBool(locations.perVertexNormalMatrix, perVertexNormalMatrix);
+}
@@ -0,0 +1,90 @@
+#include "headers/scene_graph.h"
+
+SceneGraph::SceneGraph() : sorted(true)
+{
+}
+
+unsigned int SceneGraph::add(const glm::mat4& local, unsigned int parent)
+{
+	unsigned int node = (unsigned int)slots.size();
+	unsigned int parentSlot = parent == NO_PARENT ? NO_PARENT : slots[parent];
+	unsigned int depth = parent == NO_PARENT ? 0 : depths[parentSlot] + 1;
+	// appended after a deeper node, the next update() sorts the arrays again
+	if (!depths.empty() && depth < depths.back())
+		sorted = false;
+
+	slots.push_back((unsigned int)locals.size());
+	nodes.push_back(node);
+	locals.push_back(local);
+	worlds.push_back(local);
+	parents.push_back(parentSlot);
+	depths.push_back(depth);
+	dirty.push_back(1);
+	changed.push_back(0);
+	return node;
+}
+
+void SceneGraph::setLocal(unsigned int node, const glm::mat4& local)
+{
+	unsigned int slot = slots[node];
+	locals[slot] = local;
+	dirty[slot] = 1;
+}
+
+unsigned int SceneGraph::update()
+{
+	if (!sorted)
+		sortByDepth();
+
+	unsigned int recomputed = 0;
+	for (size_t slot = 0; slot < locals.size(); slot++)
+	{
+		unsigned int parent = parents[slot];
+		bool parentChanged = parent != NO_PARENT && changed[parent];
+		changed[slot] = (dirty[slot] || parentChanged) ? 1 : 0;
+		dirty[slot] = 0;
+		if (!changed[slot])
+			continue;
+		worlds[slot] = parent == NO_PARENT ? locals[slot] : worlds[parent] * locals[slot];
+		recomputed++;
+	}
+	return recomputed;
+}
+
+// Counting sort of the slots by depth, stable so siblings keep their order. Every node is recomputed afterwards,
+// the sweep relies on the changed flags of the parents and those moved too.
+void SceneGraph::sortByDepth()
+{
+	unsigned int maxDepth = 0;
+	for (size_t slot = 0; slot < depths.size(); slot++)
+		maxDepth = depths[slot] > maxDepth ? depths[slot] : maxDepth;
+	std::vector<unsigned int> firstOfDepth(maxDepth + 2, 0);
+	for (size_t slot = 0; slot < depths.size(); slot++)
+		firstOfDepth[depths[slot] + 1]++;
+	for (unsigned int depth = 1; depth < firstOfDepth.size(); depth++)
+		firstOfDepth[depth] += firstOfDepth[depth - 1];
+
+	std::vector<unsigned int> newSlots(depths.size());
+	for (size_t slot = 0; slot < depths.size(); slot++)
+		newSlots[slot] = firstOfDepth[depths[slot]]++;
+
+	std::vector<glm::mat4> sortedLocals(locals.size()), sortedWorlds(worlds.size());
+	std::vector<unsigned int> sortedParents(parents.size()), sortedDepths(depths.size()), sortedNodes(nodes.size());
+	for (size_t slot = 0; slot < locals.size(); slot++)
+	{
+		unsigned int to = newSlots[slot];
+		sortedLocals[to] = locals[slot];
+		sortedWorlds[to] = worlds[slot];
+		sortedParents[to] = parents[slot] == NO_PARENT ? NO_PARENT : newSlots[parents[slot]];
+		sortedDepths[to] = depths[slot];
+		sortedNodes[to] = nodes[slot];
+		slots[nodes[slot]] = to;
+	}
+	locals.swap(sortedLocals);
+	worlds.swap(sortedWorlds);
+	parents.swap(sortedParents);
+	depths.swap(sortedDepths);
+	nodes.swap(sortedNodes);
+	dirty.assign(dirty.size(), 1);
+	sorted = true;
+}
@@ -1,4 +1,7 @@
 #include "headers/shader.h"
+#include "headers/frame_stats.h"
+
+#include <vector>
 
 Shader::Shader(const char* vertexPath, const char* fragmentPath)
 {
@@ -50,6 +53,7 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
 	glAttachShader(ID, fragment);
 	glLinkProgram(ID);
 	checkCompileErrors(ID, "PROGRAM");
+	cacheUniformLocations();
 	// delete the shaders as they're linked into our program now and no longer necessary
 	glDeleteShader(vertex);
 	glDeleteShader(fragment);
@@ -134,6 +138,7 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* tcs
 	glAttachShader(ID, fragment);
 	glLinkProgram(ID);
 	checkCompileErrors(ID, "PROGRAM");
+	cacheUniformLocations();
 	// delete the shaders as they're linked into our program now and no longer necessary
 	glDeleteShader(vertex);
 	glDeleteShader(tcs);
@@ -146,29 +151,75 @@ void Shader::use()
 	glUseProgram(ID);
 }
 
+void Shader::bindUniformBlock(const std::string& name, unsigned int binding) const
+{
+	unsigned int blockIndex = glGetUniformBlockIndex(ID, name.c_str());
+	if (blockIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(ID, blockIndex, binding);
+}
+
+int Shader::getUniformLocation(const std::string& name) const
+{
+	frameStats.uniformLookups++;
+	std::unordered_map<std::string, int>::const_iterator it = uniformLocations.find(name);
+	if (it == uniformLocations.end())
+		return -1;
+	return it->second;
+}
+
 void Shader::setBool(const std::string& name, bool value) const
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+	glUniform1i(getUniformLocation(name), (int)value);
 }
 
 void Shader::setInt(const std::string& name, int value) const
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	glUniform1i(getUniformLocation(name), value);
 }
 
 void Shader::setFloat(const std::string& name, float value) const
 {
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	glUniform1f(getUniformLocation(name), value);
 }
 
 void Shader::setMat4(const std::string &name, glm::mat4 value) const
 {
-	glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+	glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, glm::value_ptr(value));
 }
 
 void Shader::setVec3(const std::string& name, glm::vec3 value) const
 {
-	glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+	glUniform3fv(getUniformLocation(name), 1, glm::value_ptr(value));
+}
+
+void Shader::setBool(int location, bool value) const
+{
+	glUniform1i(location, (int)value);
+}
+
+void Shader::setInt(int location, int value) const
+{
+	glUniform1i(location, value);
+}
+
+void Shader::setFloat(int location, float value) const
+{
+	glUniform1f(location, value);
+}
+
+void Shader::setMat3(int location, const glm::mat3& value) const
+{
+	glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::setMat4(int location, const glm::mat4& value) const
+{
+	glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::setVec3(int location, const glm::vec3& value) const
+{
+	glUniform3fv(location, 1, glm::value_ptr(value));
 }
 
 void Shader::checkCompileErrors(unsigned int shader, std::string type)
@@ -193,4 +244,45 @@ void Shader::checkCompileErrors(unsigned int shader, std::string type)
 			std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
 		}
 	}
-}
\ No newline at end of file
+}
+
+void Shader::cacheUniformLocations()
+{
+	uniformLocations.clear();
+
+	int uniformCount = 0;
+	int maxNameLength = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+	if (uniformCount <= 0 || maxNameLength <= 0)
+		return;
+
+	std::vector<char> nameBuffer(maxNameLength);
+	for (int i = 0; i < uniformCount; i++)
+	{
+		GLsizei nameLength = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(ID, (GLuint)i, maxNameLength, &nameLength, &size, &type, nameBuffer.data());
+		std::string name(nameBuffer.data(), nameLength);
+
+		// arrays are reported once as "name[0]", so register every element and the bare name as well
+		std::string::size_type bracket = name.rfind("[0]");
+		bool isArray = bracket != std::string::npos && bracket + 3 == name.size();
+		std::string baseName = isArray ? name.substr(0, bracket) : name;
+		int elementCount = isArray ? size : 1;
+
+		for (int element = 0; element < elementCount; element++)
+		{
+			std::string elementName = isArray ? baseName + "[" + std::to_string(element) + "]" : baseName;
+			frameStats.driverUniformLookups++;
+			int location = glGetUniformLocation(ID, elementName.c_str());
+			// uniforms living in uniform blocks have no location
+			if (location < 0)
+				continue;
+			uniformLocations[elementName] = location;
+			if (isArray && element == 0)
+				uniformLocations[baseName] = location;
+		}
+	}
+}
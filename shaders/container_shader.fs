@@ -1,5 +1,6 @@
 #version 400 core
 #define NR_POINT_LIGHTS 1
+#define NR_FLASHLIGHTS 1
 
 out vec4 FragColor;
 
@@ -12,43 +13,70 @@ struct Material
 
 struct DirLight
 {
+    vec3 direction;
     vec3 ambient;
-    vec3 specular;
     vec3 diffuse;
+    vec3 specular;
 };
 
 struct PointLight
 {
+    vec3 position;
     float constant;
+    vec3 ambient;
     float linear;
+    vec3 diffuse;
     float quadratic;
+    vec3 specular;
+};
 
+struct Flashlight
+{
+    vec3 position;
+    float constant;
+    vec3 direction;
+    float linear;
     vec3 ambient;
+    float quadratic;
     vec3 diffuse;
+    float cutOff;
     vec3 specular;
+    float outerCutOff;
 };
 
 struct Fog
 {
+    vec3 Color;
     bool IsOn;
     float ExpDensity;
     float End;
-    vec3 Color;
+};
+
+// per frame data shared by all programs, std140 mirror of FrameUBO in headers/uniform_buffers.h
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    Fog fog;
+};
+
+// view space lights shared by all programs, std140 mirror of LightUBO in headers/uniform_buffers.h
+layout (std140) uniform LightData
+{
+    DirLight dirLight;
+    PointLight pointLights[NR_POINT_LIGHTS];
+    Flashlight flashlights[NR_FLASHLIGHTS];
 };
 
 in vec2 TextCoord;
 in vec3 Normal;
 in vec3 FragPos;
-in vec3 LightPos[NR_POINT_LIGHTS];
-in vec3 DirLightDirection;
+flat in vec4 DrawMaterial;
 
 uniform Material material;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform Fog fog;
 
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 lightDirection);
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 lightPos);
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 float CalcFogFactor();
 
 void main()
@@ -56,10 +84,10 @@ void main()
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(-FragPos);
 
-   vec3 res = CalcDirLight(dirLight, norm, viewDir, DirLightDirection);
+   vec3 res = CalcDirLight(dirLight, norm, viewDir);
 
     for(int i = 0; i < NR_POINT_LIGHTS; i++)
-        res += CalcPointLight(pointLights[i], norm, FragPos, viewDir, LightPos[i]);
+        res += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
 
     if (fog.IsOn)
     {
@@ -77,29 +105,31 @@ float CalcFogFactor()
     return exp(- DistRatio * fog.ExpDensity * DistRatio * fog.ExpDensity);
 }
 
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 lightDirection)
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
 {
-    vec3 lightDir = normalize(-lightDirection);
+    vec3 lightDir = normalize(-light.direction);
 
     vec3 reflectDir = reflect(-lightDir, normal);
 
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TextCoord));
-    vec3 diffuse = light.diffuse * max(dot(normal, lightDir), 0.0) * vec3(texture(material.diffuse, TextCoord));
-    vec3 specular = light.specular * pow(max(dot(viewDir, reflectDir), 0.0), material.shininess) * vec3(texture(material.specular, TextCoord));
+    vec3 diffuseColor = vec3(texture(material.diffuse, TextCoord)) * DrawMaterial.rgb;
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * max(dot(normal, lightDir), 0.0) * diffuseColor;
+    vec3 specular = light.specular * pow(max(dot(viewDir, reflectDir), 0.0), material.shininess * DrawMaterial.w) * vec3(texture(material.specular, TextCoord));
 
     return (ambient + specular + diffuse);
 };
 
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 lightPos)
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
-    vec3 lightDir = normalize(lightPos - fragPos);
+    vec3 lightDir = normalize(light.position - fragPos);
     vec3 reflectDir = reflect(-lightDir, normal);
 
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TextCoord));
-    vec3 diffuse = max(dot(normal, lightDir), 0.0) * light.diffuse * vec3(texture(material.diffuse, TextCoord));
-    vec3 specular = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess) * vec3(texture(material.specular,TextCoord)) * light.specular;
+    vec3 diffuseColor = vec3(texture(material.diffuse, TextCoord)) * DrawMaterial.rgb;
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = max(dot(normal, lightDir), 0.0) * light.diffuse * diffuseColor;
+    vec3 specular = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess * DrawMaterial.w) * vec3(texture(material.specular,TextCoord)) * light.specular;
 
-    float distance = length(lightPos - FragPos);
+    float distance = length(light.position - FragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
 
     return ((ambient + specular + diffuse) * attenuation);
@@ -15,60 +15,69 @@ struct Material
 
 struct DirLight
 {
+    vec3 direction;
     vec3 ambient;
-    vec3 specular;
     vec3 diffuse;
+    vec3 specular;
 };
 
 struct PointLight
 {
+    vec3 position;
     float constant;
-    float linear;
-    float quadratic;
-
     vec3 ambient;
+    float linear;
     vec3 diffuse;
+    float quadratic;
     vec3 specular;
 };
 
 struct Flashlight
 {
+    vec3 position;
     float constant;
+    vec3 direction;
     float linear;
-    float quadratic;
-
     vec3 ambient;
+    float quadratic;
     vec3 diffuse;
-    vec3 specular;
-
     float cutOff;
+    vec3 specular;
     float outerCutOff;
 };
 
 struct Fog
 {
+    vec3 Color;
     bool IsOn;
     float ExpDensity;
     float End;
-    vec3 Color;
+};
+
+// per frame data shared by all programs, std140 mirror of FrameUBO in headers/uniform_buffers.h
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    Fog fog;
+};
+
+// view space lights shared by all programs, std140 mirror of LightUBO in headers/uniform_buffers.h
+layout (std140) uniform LightData
+{
+    DirLight dirLight;
+    PointLight pointLights[NR_POINT_LIGHTS];
+    Flashlight flashlights[NR_FLASHLIGHTS];
 };
 
 in vec3 Normal;
 in vec3 FragPos;
-in vec3 LightPos[NR_POINT_LIGHTS];
-in vec3 DirLightDirection;
-in vec3 FlashlightPos[NR_FLASHLIGHTS];
-in vec3 FlashlightDir[NR_FLASHLIGHTS];
 
 uniform Material material;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform Flashlight flashlights[NR_FLASHLIGHTS];
-uniform Fog fog;
-
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 lightDirection);
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 lightPos);
-vec3 CalcFlashlight(Flashlight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 lightPos, vec3 direction);
+
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 CalcFlashlight(Flashlight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 float CalcFogFactor();
 
 void main()
@@ -80,13 +89,13 @@ void main()
     }
     vec3 viewDir = normalize(-FragPos);
 
-   vec3 res = CalcDirLight(dirLight, norm, viewDir, DirLightDirection);
+   vec3 res = CalcDirLight(dirLight, norm, viewDir);
 
     for(int i = 0; i < NR_POINT_LIGHTS; i++)
-        res += CalcPointLight(pointLights[i], norm, FragPos, viewDir, LightPos[i]);
+        res += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
 
     for(int i = 0; i < NR_FLASHLIGHTS; i++)
-		res += CalcFlashlight(flashlights[i], norm, FragPos, viewDir, FlashlightPos[i], FlashlightDir[i]);
+		res += CalcFlashlight(flashlights[i], norm, FragPos, viewDir);
 
     res *= material.Color;
 
@@ -106,9 +115,9 @@ float CalcFogFactor()
     return exp(- DistRatio * fog.ExpDensity * DistRatio * fog.ExpDensity);
 };
 
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 lightDirection)
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
 {
-    vec3 lightDir = normalize(-lightDirection);
+    vec3 lightDir = normalize(-light.direction);
     vec3 reflectDir = reflect(-lightDir, normal);
 
     vec3 ambient = light.ambient * material.ambient;
@@ -118,24 +127,24 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 lightDirection
     return (ambient + specular + diffuse);
 };
 
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 lightPos)
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
-    vec3 lightDir = normalize(lightPos - fragPos);
+    vec3 lightDir = normalize(light.position - fragPos);
     vec3 reflectDir = reflect(-lightDir, normal);
 
     vec3 ambient = light.ambient * material.ambient;
     vec3 diffuse = max(dot(normal, lightDir), 0.0) * light.diffuse * material.diffuse;
     vec3 specular = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess) * material.specular * light.specular;
 
-    float distance = length(lightPos - FragPos);
+    float distance = length(light.position - FragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
 
     return ((ambient + specular + diffuse) * attenuation);
 };
 
-vec3 CalcFlashlight(Flashlight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 lightPos, vec3 direction)
+vec3 CalcFlashlight(Flashlight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
-    vec3 lightDir = normalize(lightPos - fragPos);
+    vec3 lightDir = normalize(light.position - fragPos);
 
     vec3 reflectDir = reflect(-lightDir, normal);
 
@@ -143,11 +152,11 @@ vec3 CalcFlashlight(Flashlight light, vec3 normal, vec3 fragPos, vec3 viewDir, v
     vec3 diffuse = max(dot(normal, lightDir), 0.0) * light.diffuse * material.diffuse;
     vec3 specular = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess) * material.specular * light.specular;
 
-    float theta = dot(lightDir, normalize(-direction));
+    float theta = dot(lightDir, normalize(-light.direction));
     float epsilon = (light.cutOff - light.outerCutOff);
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
 
-    float distance = length(lightPos - fragPos);
+    float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * distance * distance);
 
     return ((ambient + specular + diffuse) * attenuation * intensity);
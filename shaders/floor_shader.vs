@@ -1,39 +1,49 @@
 #version 400 core
-#define NR_POINT_LIGHTS 1
-#define NR_FLASHLIGHTS 1
 
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTextCoord;
+// index of the draw's data, see IndirectRenderer in headers/indirect_renderer.h
+layout (location = 7) in uint aDrawIndex;
 
 out vec2 TextCoord;
 out vec3 Normal;
 out vec3 FragPos;
-out vec3 pointLightPos[NR_POINT_LIGHTS];
-out vec3 DirLightDirection;
-out vec3 FlashlightPos[NR_FLASHLIGHTS];
-out vec3 FlashlightDir[NR_FLASHLIGHTS];
 
-uniform vec3 lightPos[NR_POINT_LIGHTS];
-uniform vec3 dirLightDirection;
-uniform vec3 flashlightPos[NR_FLASHLIGHTS];
-uniform vec3 flashlightDir[NR_FLASHLIGHTS];
+struct Fog
+{
+    vec3 Color;
+    bool IsOn;
+    float ExpDensity;
+    float End;
+};
+
+// per frame data shared by all programs, std140 mirror of FrameUBO in headers/uniform_buffers.h
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    Fog fog;
+};
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per draw transforms computed once on the CPU, 8 texels per draw: the model view matrix, the normal matrix columns
+// and the material parameters
+uniform samplerBuffer drawData;
+// comparison mode, inverts the matrix per vertex like before
+uniform bool perVertexNormalMatrix;
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(aPos, 1.0);
-	FragPos = vec3(view * model * vec4(aPos, 1.0));
-	Normal = mat3(transpose(inverse(view * model))) * aNormal;
-	for(int i = 0; i < NR_POINT_LIGHTS; i++)
-		pointLightPos[i] = vec3(view * vec4(lightPos[i], 1.0));
-	for(int i = 0; i < NR_FLASHLIGHTS; i++)
-		FlashlightPos[i] = vec3(view * vec4(flashlightPos[i], 1.0));
-	for(int i = 0; i < NR_FLASHLIGHTS; i++)
-		FlashlightDir[i] = normalize(mat3(view) * flashlightDir[i]);
-	DirLightDirection = normalize(mat3(view) * dirLightDirection);
+	int base = int(aDrawIndex) * 8;
+	mat4 modelView = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1), texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
+	mat3 normalMatrix = mat3(texelFetch(drawData, base + 4).xyz, texelFetch(drawData, base + 5).xyz, texelFetch(drawData, base + 6).xyz);
+
+	vec4 viewPos = modelView * vec4(aPos, 1.0);
+	gl_Position = projection * viewPos;
+	FragPos = vec3(viewPos);
+	if (perVertexNormalMatrix)
+		Normal = mat3(transpose(inverse(modelView))) * aNormal;
+	else
+		Normal = normalMatrix * aNormal;
 	TextCoord = aTextCoord;
 };
\ No newline at end of file
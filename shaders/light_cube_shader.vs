@@ -1,9 +1,23 @@
 #version 400 core
 layout (location = 0) in vec3 aPos;
 
+struct Fog
+{
+    vec3 Color;
+    bool IsOn;
+    float ExpDensity;
+    float End;
+};
+
+// per frame data shared by all programs, std140 mirror of FrameUBO in headers/uniform_buffers.h
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    Fog fog;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main()
 {
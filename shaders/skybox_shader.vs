@@ -4,12 +4,26 @@ layout (location = 0) in vec3 aPos;
 
 out vec3 TextCoord;
 
-uniform mat4 projection;
-uniform mat4 view;
+struct Fog
+{
+    vec3 Color;
+    bool IsOn;
+    float ExpDensity;
+    float End;
+};
+
+// per frame data shared by all programs, std140 mirror of FrameUBO in headers/uniform_buffers.h
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    Fog fog;
+};
 
 void main()
 {
     TextCoord = aPos;
-    vec4 pos = projection * view * vec4(aPos, 1.0);
+    // drop the translation so the skybox stays centered on the camera
+    vec4 pos = projection * mat4(mat3(view)) * vec4(aPos, 1.0);
     gl_Position = pos.xyww;
 }  
\ No newline at end of file
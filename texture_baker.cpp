@@ -0,0 +1,272 @@
+#include "headers/texture_baker.h"
+#include "headers/block_compression.h"
+#include "headers/ktx_texture.h"
+#include "headers/texture_loader.h"
+
+#include "headers/stb_image.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+// files and subdirectories of a directory, sorted so the report has a stable order
+static void listDirectory(const std::string& directory, std::vector<std::string>& files, std::vector<std::string>& directories)
+{
+#ifdef _WIN32
+	WIN32_FIND_DATAA entry;
+	HANDLE find = FindFirstFileA((directory + "*").c_str(), &entry);
+	if (find == INVALID_HANDLE_VALUE)
+		return;
+	do
+	{
+		std::string name = entry.cFileName;
+		if (name == "." || name == "..")
+			continue;
+		if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			directories.push_back(name);
+		else
+			files.push_back(name);
+	} while (FindNextFileA(find, &entry));
+	FindClose(find);
+#else
+	DIR* dir = opendir(directory.c_str());
+	if (!dir)
+		return;
+	while (dirent* entry = readdir(dir))
+	{
+		std::string name = entry->d_name;
+		struct stat info;
+		if (name == "." || name == ".." || stat((directory + name).c_str(), &info) != 0)
+			continue;
+		if (S_ISDIR(info.st_mode))
+			directories.push_back(name);
+		else
+			files.push_back(name);
+	}
+	closedir(dir);
+#endif
+	std::sort(files.begin(), files.end());
+	std::sort(directories.begin(), directories.end());
+}
+
+static std::string lowercase(std::string text)
+{
+	for (size_t i = 0; i < text.size(); i++)
+		text[i] = (char)std::tolower((unsigned char)text[i]);
+	return text;
+}
+
+static bool isImage(const std::string& name)
+{
+	std::string lower = lowercase(name);
+	size_t dot = lower.find_last_of('.');
+	if (dot == std::string::npos)
+		return false;
+	std::string extension = lower.substr(dot);
+	return extension == ".jpg" || extension == ".jpeg" || extension == ".png";
+}
+
+// next mip level with a 2x2 box filter, odd edges repeat their last texel
+static void downsample(const std::vector<unsigned char>& source, int width, int height, std::vector<unsigned char>& out)
+{
+	int outWidth = std::max(1, width / 2), outHeight = std::max(1, height / 2);
+	out.resize((size_t)outWidth * outHeight * 4);
+	for (int y = 0; y < outHeight; y++)
+	{
+		int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+		for (int x = 0; x < outWidth; x++)
+		{
+			int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+			for (int c = 0; c < 4; c++)
+			{
+				int sum = source[4 * ((size_t)y0 * width + x0) + c] + source[4 * ((size_t)y0 * width + x1) + c]
+					+ source[4 * ((size_t)y1 * width + x0) + c] + source[4 * ((size_t)y1 * width + x1) + c];
+				out[4 * ((size_t)y * outWidth + x) + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+static const char* formatName(BlockFormat format)
+{
+	static const char* names[] = { "BC1", "BC3", "BC5", "BC7" };
+	return names[format];
+}
+
+static unsigned int compressedFormat(BlockFormat format, unsigned int& baseFormat)
+{
+	switch (format)
+	{
+	case BLOCK_BC1:
+		baseFormat = GL_RGB;
+		return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case BLOCK_BC3:
+		baseFormat = GL_RGBA;
+		return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case BLOCK_BC5:
+		baseFormat = GL_RG;
+		return GL_COMPRESSED_RG_RGTC2;
+	default:
+		baseFormat = GL_RGBA;
+		return GL_COMPRESSED_RGBA_BPTC_UNORM;
+	}
+}
+
+struct BakeTotals
+{
+	size_t sourceBytes;
+	size_t bakedBytes;
+	double sourceTime;
+	double bakedTime;
+	int failed;
+};
+
+// Bakes the images (one, or the six faces of a cubemap) into one KTX file and reports it.
+// Uncompressed video memory is counted at four bytes per texel, drivers pad RGB to RGBA. The load time is the CPU
+// side: stbi_load of the sources against mapping the KTX file and reading every page of it, both after the files
+// were read once, and without the glGenerateMipmap the sources needed on top.
+static void bake(const std::vector<std::string>& sources, const std::string& output, bool mipmaps, bool bc7, BakeTotals& totals)
+{
+	typedef std::chrono::steady_clock clock;
+	std::vector<std::vector<unsigned char> > pixels(sources.size());
+	int width = 0, height = 0;
+	bool transparent = false;
+	double sourceTime = 0.0;
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		clock::time_point start = clock::now();
+		int components;
+		unsigned char* data = stbi_load(sources[i].c_str(), &width, &height, &components, 4);
+		sourceTime += std::chrono::duration<double>(clock::now() - start).count();
+		if (!data)
+		{
+			std::cout << "bake: failed to load " << sources[i] << std::endl;
+			totals.failed++;
+			return;
+		}
+		pixels[i].assign(data, data + (size_t)width * height * 4);
+		stbi_image_free(data);
+		for (size_t k = 3; components == 4 && k < pixels[i].size(); k += 4)
+			transparent = transparent || pixels[i][k] < 255;
+	}
+
+	BlockFormat format = BLOCK_BC1;
+	if (lowercase(output).find("normal") != std::string::npos)
+		format = BLOCK_BC5;
+	else if (bc7)
+		format = BLOCK_BC7;
+	else if (transparent)
+		format = BLOCK_BC3;
+
+	// level by level, every face at each level
+	int faces = (int)sources.size();
+	std::vector<std::vector<unsigned char> > images;
+	size_t sourceBytes = 0;
+	int levelWidth = width, levelHeight = height;
+	while (true)
+	{
+		for (int face = 0; face < faces; face++)
+		{
+			images.push_back(std::vector<unsigned char>());
+			compressImage(format, pixels[face].data(), levelWidth, levelHeight, images.back());
+		}
+		sourceBytes += (size_t)levelWidth * levelHeight * 4 * faces;
+		if (!mipmaps || (levelWidth == 1 && levelHeight == 1))
+			break;
+		for (int face = 0; face < faces; face++)
+		{
+			std::vector<unsigned char> next;
+			downsample(pixels[face], levelWidth, levelHeight, next);
+			pixels[face].swap(next);
+		}
+		levelWidth = std::max(1, levelWidth / 2);
+		levelHeight = std::max(1, levelHeight / 2);
+	}
+
+	unsigned int baseFormat;
+	unsigned int internalFormat = compressedFormat(format, baseFormat);
+	if (!KtxTexture::write(output, internalFormat, baseFormat, width, height, faces, images))
+	{
+		std::cout << "bake: failed to write " << output << std::endl;
+		totals.failed++;
+		return;
+	}
+
+	KtxTexture baked;
+	clock::time_point start = clock::now();
+	bool opened = baked.open(output);
+	if (opened)
+		baked.touchPages();
+	double bakedTime = std::chrono::duration<double>(clock::now() - start).count();
+	if (!opened)
+	{
+		std::cout << "bake: cannot read back " << output << std::endl;
+		totals.failed++;
+		return;
+	}
+
+	totals.sourceBytes += sourceBytes;
+	totals.bakedBytes += baked.getDataSize();
+	totals.sourceTime += sourceTime;
+	totals.bakedTime += bakedTime;
+	std::cout << std::fixed << std::setprecision(1) << output << ": " << width << "x" << height << (faces == 6 ? " cubemap " : " ")
+		<< formatName(format) << ", " << baked.getLevelCount() << " levels, vram " << sourceBytes / 1024.0 / 1024.0 << " -> "
+		<< baked.getDataSize() / 1024.0 / 1024.0 << " MB, load " << sourceTime * 1000.0 << " -> " << bakedTime * 1000.0 << " ms"
+		<< std::endl;
+}
+
+static void bakeDirectory(const std::string& directory, bool bc7, BakeTotals& totals)
+{
+	std::vector<std::string> files, directories;
+	listDirectory(directory, files, directories);
+
+	// the six faces make a cubemap, it has no mipmaps like the skybox always had
+	std::vector<std::string> faces;
+	for (int i = 0; i < 6; i++)
+		if (std::find(files.begin(), files.end(), TextureLoader::CUBEMAP_FACES[i]) != files.end())
+			faces.push_back(directory + TextureLoader::CUBEMAP_FACES[i]);
+	if (faces.size() == 6)
+		bake(faces, TextureLoader::bakedCubemapPath(directory), false, bc7, totals);
+	else
+		faces.clear();
+
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		std::string path = directory + files[i];
+		if (isImage(files[i]) && std::find(faces.begin(), faces.end(), path) == faces.end())
+			bake(std::vector<std::string>(1, path), TextureLoader::bakedPath(path), true, bc7, totals);
+	}
+	for (size_t i = 0; i < directories.size(); i++)
+		bakeDirectory(directory + directories[i] + "/", bc7, totals);
+}
+
+int runTextureBaker(const std::string& directory, bool bc7)
+{
+	BakeTotals totals = {};
+	std::string root = directory;
+	if (!root.empty() && root[root.size() - 1] != '/' && root[root.size() - 1] != '\\')
+		root += '/';
+
+	stbi_set_flip_vertically_on_load(false);
+	bakeDirectory(root, bc7, totals);
+
+	std::cout << std::fixed << std::setprecision(1) << "bake: vram " << totals.sourceBytes / 1024.0 / 1024.0 << " -> "
+		<< totals.bakedBytes / 1024.0 / 1024.0 << " MB, load " << totals.sourceTime * 1000.0 << " -> "
+		<< totals.bakedTime * 1000.0 << " ms";
+	if (totals.failed > 0)
+		std::cout << ", " << totals.failed << " failed";
+	std::cout << std::endl;
+	return totals.failed > 0 ? 1 : 0;
+}
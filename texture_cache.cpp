@@ -0,0 +1,219 @@
+#include "headers/texture_cache.h"
+#include "headers/texture_loader.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#define getcwd _getcwd
+#else
+#include <unistd.h>
+#endif
+
+// video memory of all levels as the driver reports them, uncompressed RGB counts as RGBA since drivers pad it
+static size_t textureBytes(unsigned int name, bool cubemap)
+{
+	GLenum target = cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : GL_TEXTURE_2D;
+	glBindTexture(cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D, name);
+	size_t bytes = 0;
+	for (int level = 0; level < 32; level++)
+	{
+		int width = 0, height = 0, compressed = 0, size = 0, format = 0;
+		glGetTexLevelParameteriv(target, level, GL_TEXTURE_WIDTH, &width);
+		if (width == 0)
+			break;
+		glGetTexLevelParameteriv(target, level, GL_TEXTURE_HEIGHT, &height);
+		glGetTexLevelParameteriv(target, level, GL_TEXTURE_COMPRESSED, &compressed);
+		if (compressed)
+		{
+			glGetTexLevelParameteriv(target, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+			bytes += size;
+			continue;
+		}
+		glGetTexLevelParameteriv(target, level, GL_TEXTURE_INTERNAL_FORMAT, &format);
+		int texelSize = 4;
+		if (format == GL_RED || format == GL_R8)
+			texelSize = 1;
+		else if (format == GL_RG || format == GL_RG8)
+			texelSize = 2;
+		bytes += (size_t)width * height * texelSize;
+	}
+	return bytes * (cubemap ? 6 : 1);
+}
+
+TextureCache::TextureCache(TextureLoader* loader, size_t budget)
+	: loader(loader), budget(budget), residentBytes(0), useCounter(0), hits(0), misses(0), evictions(0)
+{
+}
+
+TextureCache::~TextureCache()
+{
+	for (EntryMap::iterator it = entries.begin(); it != entries.end(); ++it)
+		glDeleteTextures(1, &it->second.name);
+}
+
+unsigned int TextureCache::acquire2D(const std::string& path, ColorSpace colorSpace)
+{
+	return acquire(path, false, colorSpace);
+}
+
+unsigned int TextureCache::acquireCubemap(const std::string& directory, ColorSpace colorSpace)
+{
+	return acquire(directory, true, colorSpace);
+}
+
+unsigned int TextureCache::acquire(const std::string& path, bool cubemap, ColorSpace colorSpace)
+{
+	std::string key = canonicalPath(path);
+	key += '|';
+	key += cubemap ? 'c' : 't';
+	key += colorSpace == COLOR_SRGB ? 's' : 'l';
+	key += loader->getFlipVertically() ? 'f' : 'u';
+
+	EntryMap::iterator found = entries.find(key);
+	if (found != entries.end())
+	{
+		hits++;
+		found->second.references++;
+		found->second.lastUse = ++useCounter;
+		return found->second.name;
+	}
+
+	misses++;
+	Entry entry;
+	bool srgb = colorSpace == COLOR_SRGB;
+	entry.name = cubemap ? loader->addCubemap(path, srgb) : loader->add2D(path, srgb);
+	entry.cubemap = cubemap;
+	entry.colorSpace = colorSpace;
+	entry.references = 1;
+	entry.bytes = 0;
+	entry.measured = false;
+	entry.lastUse = ++useCounter;
+	entries[key] = entry;
+	keys[entry.name] = key;
+	trim();
+	return entry.name;
+}
+
+void TextureCache::release(unsigned int texture)
+{
+	std::unordered_map<unsigned int, std::string>::iterator key = keys.find(texture);
+	if (key == keys.end())
+		return;
+	Entry& entry = entries[key->second];
+	if (entry.references > 0)
+		entry.references--;
+	entry.lastUse = ++useCounter;
+	trim();
+}
+
+void TextureCache::setBudget(size_t bytes)
+{
+	budget = bytes;
+	trim();
+}
+
+void TextureCache::trim()
+{
+	if (!loader->isIdle())
+		return;
+
+	for (EntryMap::iterator it = entries.begin(); it != entries.end(); ++it)
+	{
+		Entry& entry = it->second;
+		if (entry.measured)
+			continue;
+		entry.bytes = textureBytes(entry.name, entry.cubemap);
+		entry.measured = true;
+		residentBytes += entry.bytes;
+	}
+	if (residentBytes <= budget)
+		return;
+
+	// least recently used first
+	std::vector<std::pair<unsigned long long, std::string> > unused;
+	for (EntryMap::iterator it = entries.begin(); it != entries.end(); ++it)
+		if (it->second.references == 0)
+			unused.push_back(std::make_pair(it->second.lastUse, it->first));
+	std::sort(unused.begin(), unused.end());
+	for (size_t i = 0; i < unused.size() && residentBytes > budget; i++)
+		evict(unused[i].second);
+}
+
+void TextureCache::evict(const std::string& key)
+{
+	EntryMap::iterator found = entries.find(key);
+	Entry& entry = found->second;
+	glDeleteTextures(1, &entry.name);
+	if (entry.measured)
+		residentBytes -= entry.bytes;
+	keys.erase(entry.name);
+	entries.erase(found);
+	evictions++;
+}
+
+void TextureCache::printReport(std::ostream& out) const
+{
+	int referenced = 0, srgb = 0;
+	for (EntryMap::const_iterator it = entries.begin(); it != entries.end(); ++it)
+	{
+		referenced += it->second.references > 0 ? 1 : 0;
+		srgb += it->second.colorSpace == COLOR_SRGB ? 1 : 0;
+	}
+	int lookups = hits + misses;
+	out << std::fixed << std::setprecision(1);
+	out << "texture cache: " << entries.size() << " textures (" << referenced << " referenced, " << srgb << " sRGB), "
+		<< residentBytes / 1024.0 / 1024.0 << " of " << budget / 1024.0 / 1024.0 << " MB, " << hits << " hits and " << misses
+		<< " misses (" << (lookups > 0 ? 100.0 * hits / lookups : 0.0) << "%), " << evictions << " evicted" << std::endl;
+	out.unsetf(std::ios::floatfield);
+	out << std::setprecision(6);
+}
+
+std::string TextureCache::canonicalPath(const std::string& path)
+{
+	std::string full = path;
+	bool absolute = !full.empty() && (full[0] == '/' || full[0] == '\\');
+#ifdef _WIN32
+	absolute = absolute || (full.size() > 1 && full[1] == ':');
+#endif
+	char directory[4096];
+	if (!absolute && getcwd(directory, sizeof(directory)))
+		full = std::string(directory) + "/" + full;
+	std::replace(full.begin(), full.end(), '\\', '/');
+#ifdef _WIN32
+	for (size_t i = 0; i < full.size(); i++)
+		full[i] = (char)std::tolower((unsigned char)full[i]);
+#endif
+
+	// the root ("/" or a drive like "c:/") is kept as it is, the segments after it are resolved
+	size_t rootLength = full.find('/') + 1;
+	std::vector<std::string> segments;
+	for (size_t begin = rootLength; begin <= full.size();)
+	{
+		size_t end = full.find('/', begin);
+		if (end == std::string::npos)
+			end = full.size();
+		std::string segment = full.substr(begin, end - begin);
+		if (segment == "..")
+		{
+			if (!segments.empty())
+				segments.pop_back();
+		}
+		else if (!segment.empty() && segment != ".")
+			segments.push_back(segment);
+		begin = end + 1;
+	}
+
+	std::string canonical = full.substr(0, rootLength);
+	for (size_t i = 0; i < segments.size(); i++)
+		canonical += (i > 0 ? "/" : "") + segments[i];
+	if (!segments.empty() && full[full.size() - 1] == '/')
+		canonical += '/';
+	return canonical;
+}
@@ -0,0 +1,428 @@
+#include "headers/texture_loader.h"
+#include "headers/thread_pool.h"
+
+#include "headers/stb_image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+
+// shown until the image is uploaded
+static const unsigned char PLACEHOLDER[3] = { 128, 128, 128 };
+
+const char* const TextureLoader::CUBEMAP_FACES[6] = { "right.jpg", "left.jpg", "top.jpg", "bottom.jpg", "front.jpg", "back.jpg" };
+
+static GLenum imageFormat(int components)
+{
+	if (components == 1)
+		return GL_RED;
+	if (components == 2)
+		return GL_RG;
+	if (components == 4)
+		return GL_RGBA;
+	return GL_RGB;
+}
+
+static GLenum internalFormat(int components, bool srgb)
+{
+	if (srgb && components == 3)
+		return GL_SRGB8;
+	if (srgb && components == 4)
+		return GL_SRGB8_ALPHA8;
+	return imageFormat(components);
+}
+
+TextureLoader::TextureLoader(ThreadPool* pool)
+	: pool(pool), flipVertically(false), cancelled(false), streaming(false), nextImage(0), decodeTime(0.0), uploadTime(0.0),
+	pbo(0), region(0)
+{
+	for (int i = 0; i < UPLOAD_REGIONS; i++)
+		fences[i] = 0;
+}
+
+// an unfinished stream is abandoned, its textures keep their placeholders
+TextureLoader::~TextureLoader()
+{
+	if (decoder.joinable())
+	{
+		cancelled = true;
+		decoder.join();
+	}
+	for (size_t i = 0; i < images.size(); i++)
+		stbi_image_free(images[i].data);
+
+	for (int i = 0; i < UPLOAD_REGIONS; i++)
+		if (fences[i])
+			glDeleteSync(fences[i]);
+	if (pbo)
+		glDeleteBuffers(1, &pbo);
+}
+
+unsigned int TextureLoader::add2D(const std::string& path, bool srgb)
+{
+	int texture = addTexture(false, srgb);
+	if (!addBaked(bakedPath(path), texture))
+		addImage(path, texture, GL_TEXTURE_2D);
+	return queuedTextures[texture].name;
+}
+
+unsigned int TextureLoader::addCubemap(const std::string& directory, bool srgb)
+{
+	int texture = addTexture(true, srgb);
+	if (!addBaked(bakedCubemapPath(directory), texture))
+		for (unsigned int i = 0; i < 6; i++)
+			addImage(directory + CUBEMAP_FACES[i], texture, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i);
+	return queuedTextures[texture].name;
+}
+
+int TextureLoader::addTexture(bool cubemap, bool srgb)
+{
+	StreamedTexture texture;
+	texture.cubemap = cubemap;
+	texture.srgb = srgb;
+	texture.allocated = false;
+	texture.imagesLeft = 0;
+	glGenTextures(1, &texture.name);
+
+	if (cubemap)
+	{
+		glBindTexture(GL_TEXTURE_CUBE_MAP, texture.name);
+		for (unsigned int i = 0; i < 6; i++)
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, PLACEHOLDER);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	}
+	else
+	{
+		glBindTexture(GL_TEXTURE_2D, texture.name);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, PLACEHOLDER);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		// the placeholder has no mipmaps
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	}
+
+	queuedTextures.push_back(texture);
+	return (int)queuedTextures.size() - 1;
+}
+
+void TextureLoader::addImage(const std::string& path, int texture, unsigned int target)
+{
+	Image image;
+	image.path = path;
+	image.flip = flipVertically;
+	image.texture = texture;
+	image.target = target;
+	image.data = NULL;
+	image.width = image.height = image.components = 0;
+	image.rowsUploaded = 0;
+	image.done = false;
+	image.decodeBegin = image.decodeEnd = image.uploadBegin = image.uploadEnd = 0.0;
+	queuedImages.push_back(image);
+	queuedTextures[texture].imagesLeft++;
+}
+
+bool TextureLoader::addBaked(const std::string& path, int texture)
+{
+	if (flipVertically)
+		return false;
+	// only the header is read here, the blocks are paged in by the decoder
+	std::shared_ptr<KtxTexture> baked(new KtxTexture());
+	if (!baked->open(path) || (baked->getFaceCount() == 6) != queuedTextures[texture].cubemap)
+		return false;
+	unsigned int format = baked->getInternalFormat();
+	if (queuedTextures[texture].srgb && KtxTexture::srgbFormat(format))
+		format = KtxTexture::srgbFormat(format);
+	if (!KtxTexture::isFormatSupported(format))
+		return false;
+
+	addImage(path, texture, queuedTextures[texture].cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D);
+	Image& image = queuedImages.back();
+	image.baked = baked;
+	image.width = baked->getWidth();
+	image.height = baked->getHeight();
+	return true;
+}
+
+void TextureLoader::startStreaming()
+{
+	if (streaming || queuedImages.empty())
+		return;
+	images.swap(queuedImages);
+	textures.swap(queuedTextures);
+	queuedImages.clear();
+	queuedTextures.clear();
+
+	if (!pbo)
+	{
+		glGenBuffers(1, &pbo);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, UPLOAD_REGIONS * REGION_SIZE, NULL, GL_STREAM_DRAW);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	decoded.reset(new std::atomic<bool>[images.size()]);
+	for (size_t i = 0; i < images.size(); i++)
+		decoded[i] = false;
+	cancelled = false;
+	streaming = true;
+	nextImage = 0;
+	uploadTime = 0.0;
+	start = clock::now();
+
+	// the decoder thread is the calling thread of the pool, it only waits for the other threads at the end
+	decoder = std::thread([this]()
+	{
+		std::function<void(int, int)> decodeImages = [this](int begin, int end)
+		{
+			for (int i = begin; i < end && !cancelled; i++)
+			{
+				decode(images[i]);
+				decoded[i].store(true, std::memory_order_release);
+			}
+		};
+		if (pool)
+			pool->parallelFor((int)images.size(), 1, decodeImages);
+		else
+			decodeImages(0, (int)images.size());
+		decodeTime = std::chrono::duration<double>(clock::now() - start).count();
+	});
+}
+
+int TextureLoader::update()
+{
+	if (!streaming)
+		return 0;
+	clock::time_point updateStart = clock::now();
+	int texturesLeft = 0;
+	for (size_t i = 0; i < textures.size(); i++)
+		texturesLeft += textures[i].imagesLeft > 0 ? 1 : 0;
+
+	// the first decoded image in queue order gets this frame's region, images that failed to decode cost nothing
+	for (size_t i = nextImage; i < images.size(); i++)
+	{
+		Image& image = images[i];
+		if (image.done || !decoded[i].load(std::memory_order_acquire))
+			continue;
+
+		if (image.baked)
+		{
+			image.uploadBegin = std::chrono::duration<double>(clock::now() - start).count();
+			image.baked->upload(textures[image.texture].name, textures[image.texture].srgb);
+			imageDone(image);
+			break;
+		}
+		if (!image.data)
+		{
+			std::cout << "Texture failed to load at path: " << image.path << std::endl;
+			imageDone(image);
+			continue;
+		}
+		if (uploadRows(image) && image.rowsUploaded == image.height)
+			imageDone(image);
+		break;
+	}
+
+	while (nextImage < images.size() && images[nextImage].done)
+		nextImage++;
+	uploadTime += std::chrono::duration<double>(clock::now() - updateStart).count();
+
+	int completed = texturesLeft;
+	for (size_t i = 0; i < textures.size(); i++)
+		completed -= textures[i].imagesLeft > 0 ? 1 : 0;
+
+	if (nextImage == images.size())
+		endStreaming();
+	return completed;
+}
+
+bool TextureLoader::uploadRows(Image& image)
+{
+	size_t rowSize = (size_t)image.width * image.components;
+	int rows = std::min(image.height - image.rowsUploaded, (int)(REGION_SIZE / rowSize));
+	if (rows == 0)
+	{
+		// a single row larger than a region, only for absurdly wide images
+		std::cout << "Texture too wide to stream: " << image.path << std::endl;
+		image.rowsUploaded = image.height;
+		return true;
+	}
+
+	// the region is only reused once the GPU has finished the upload that last read from it
+	int next = (region + 1) % UPLOAD_REGIONS;
+	if (fences[next])
+	{
+		if (glClientWaitSync(fences[next], GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
+			return false;
+		glDeleteSync(fences[next]);
+		fences[next] = 0;
+	}
+	region = next;
+
+	StreamedTexture& texture = textures[image.texture];
+	if (image.rowsUploaded == 0)
+		image.uploadBegin = std::chrono::duration<double>(clock::now() - start).count();
+	if (!texture.allocated)
+		allocate(texture, image);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+	size_t offset = region * REGION_SIZE;
+	void* target = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, rows * rowSize,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	const unsigned char* pixels = image.data + image.rowsUploaded * rowSize;
+	if (target)
+	{
+		std::memcpy(target, pixels, rows * rowSize);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		pixels = (const unsigned char*)offset;
+	}
+	else
+	{
+		// the mapping failed, upload straight from client memory
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	// decoded rows are tightly packed
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glBindTexture(texture.cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D, texture.name);
+	GLenum format = imageFormat(image.components);
+	glTexSubImage2D(image.target, 0, 0, image.rowsUploaded, image.width, rows, format, GL_UNSIGNED_BYTE, pixels);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	image.rowsUploaded += rows;
+	return true;
+}
+
+// Level 0 gets its full size (all faces of a cubemap take the size of the first one), while sampling stays on a
+// 1x1 placeholder at the level a full mip chain would end with
+void TextureLoader::allocate(StreamedTexture& texture, const Image& image)
+{
+	GLenum bindTarget = texture.cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+	int lastLevel = 0;
+	for (int size = std::max(image.width, image.height); size > 1; size /= 2)
+		lastLevel++;
+
+	GLenum format = imageFormat(image.components);
+	glBindTexture(bindTarget, texture.name);
+	for (unsigned int face = 0; face < (texture.cubemap ? 6u : 1u); face++)
+	{
+		GLenum target = texture.cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+		glTexImage2D(target, 0, internalFormat(image.components, texture.srgb), image.width, image.height, 0, format, GL_UNSIGNED_BYTE, NULL);
+		glTexImage2D(target, lastLevel, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, PLACEHOLDER);
+	}
+	glTexParameteri(bindTarget, GL_TEXTURE_BASE_LEVEL, lastLevel);
+	glTexParameteri(bindTarget, GL_TEXTURE_MAX_LEVEL, lastLevel);
+	texture.allocated = true;
+}
+
+void TextureLoader::imageDone(Image& image)
+{
+	if (image.data || image.baked)
+		image.uploadEnd = std::chrono::duration<double>(clock::now() - start).count();
+	stbi_image_free(image.data);
+	image.data = NULL;
+	image.baked.reset();
+	image.done = true;
+
+	StreamedTexture& texture = textures[image.texture];
+	if (--texture.imagesLeft == 0 && texture.allocated)
+		complete(texture);
+}
+
+// switches sampling from the placeholder to the uploaded level 0
+void TextureLoader::complete(StreamedTexture& texture)
+{
+	GLenum bindTarget = texture.cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+	glBindTexture(bindTarget, texture.name);
+	glTexParameteri(bindTarget, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(bindTarget, GL_TEXTURE_MAX_LEVEL, 1000);
+	if (!texture.cubemap)
+		glGenerateMipmap(GL_TEXTURE_2D);
+}
+
+void TextureLoader::endStreaming()
+{
+	decoder.join();
+	timeline.swap(images);
+	images.clear();
+	textures.clear();
+	decoded.reset();
+	streaming = false;
+	// images queued during the stream
+	startStreaming();
+}
+
+void TextureLoader::finish()
+{
+	startStreaming();
+	while (streaming)
+	{
+		update();
+		// waiting for the decoder or for a region the GPU still reads
+		std::this_thread::yield();
+	}
+}
+
+void TextureLoader::decode(Image& image)
+{
+	image.decodeThread = std::this_thread::get_id();
+	image.decodeBegin = std::chrono::duration<double>(clock::now() - start).count();
+	if (image.baked)
+	{
+		image.baked->touchPages();
+		image.decodeEnd = std::chrono::duration<double>(clock::now() - start).count();
+		return;
+	}
+	// stb's global flip setting is overridden for this thread, whatever it is, and the rows are flipped here instead
+	stbi_set_flip_vertically_on_load_thread(0);
+	image.data = stbi_load(image.path.c_str(), &image.width, &image.height, &image.components, 0);
+	if (image.data && image.flip)
+	{
+		size_t rowSize = (size_t)image.width * image.components;
+		for (int row = 0; row < image.height / 2; row++)
+		{
+			unsigned char* top = image.data + row * rowSize;
+			std::swap_ranges(top, top + rowSize, image.data + (image.height - 1 - row) * rowSize);
+		}
+	}
+	image.decodeEnd = std::chrono::duration<double>(clock::now() - start).count();
+}
+
+void TextureLoader::printTimeline(std::ostream& out) const
+{
+	// decoding threads are numbered in the order they first show up
+	std::vector<std::thread::id> threads;
+	double resident = 0.0;
+	for (size_t i = 0; i < timeline.size(); i++)
+	{
+		if (std::find(threads.begin(), threads.end(), timeline[i].decodeThread) == threads.end())
+			threads.push_back(timeline[i].decodeThread);
+		resident = std::max(resident, timeline[i].uploadEnd);
+	}
+
+	out << std::fixed << std::setprecision(1);
+	out << "textures: " << timeline.size() << " images decoded in " << decodeTime * 1000.0 << " ms on " << threads.size()
+		<< " threads, all resident after " << resident * 1000.0 << " ms, " << uploadTime * 1000.0 << " ms spent uploading" << std::endl;
+	for (size_t i = 0; i < timeline.size(); i++)
+	{
+		const Image& image = timeline[i];
+		int thread = (int)(std::find(threads.begin(), threads.end(), image.decodeThread) - threads.begin());
+		out << "  decode " << std::setw(7) << image.decodeBegin * 1000.0 << " - " << std::setw(7) << image.decodeEnd * 1000.0
+			<< " ms (thread " << thread << "), ";
+		if (image.width > 0)
+			out << "upload " << std::setw(7) << image.uploadBegin * 1000.0 << " - " << std::setw(7) << image.uploadEnd * 1000.0
+				<< " ms  " << image.width << "x" << image.height << "  " << image.path << std::endl;
+		else
+			out << "failed  " << image.path << std::endl;
+	}
+	out.unsetf(std::ios::floatfield);
+	out << std::setprecision(6);
+}
@@ -0,0 +1,121 @@
+#include "headers/thread_pool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threadCount) : jobGeneration(0), stopping(false), body(NULL), pendingRanges(0), steals(0)
+{
+	threadCount = std::max(threadCount, 1);
+	for (int i = 0; i < threadCount; i++)
+		queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+
+	// queue 0 belongs to the calling thread
+	for (int i = 1; i < threadCount; i++)
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		stopping = true;
+	}
+	jobReady.notify_all();
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+void ThreadPool::parallelFor(int count, int grain, const std::function<void(int, int)>& function)
+{
+	if (count <= 0)
+		return;
+	grain = std::max(grain, 1);
+	int chunks = (count + grain - 1) / grain;
+	int threads = getThreadCount();
+
+	if (threads == 1 || chunks == 1)
+	{
+		for (int begin = 0; begin < count; begin += grain)
+			function(begin, std::min(begin + grain, count));
+		return;
+	}
+
+	std::lock_guard<std::mutex> call(callMutex);
+	// the body is published before any range, a thread that pops a range always sees the body it belongs to
+	body = &function;
+	pendingRanges.store(chunks);
+	for (int chunk = 0; chunk < chunks; chunk++)
+	{
+		int begin = chunk * grain;
+		WorkQueue& queue = *queues[(long long)chunk * threads / chunks];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.ranges.push_back(std::make_pair(begin, std::min(begin + grain, count)));
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		jobGeneration++;
+	}
+	jobReady.notify_all();
+
+	while (runOne(0))
+		;
+	// the last chunks may still be running on the workers
+	while (pendingRanges.load() > 0)
+		std::this_thread::yield();
+}
+
+void ThreadPool::workerLoop(int index)
+{
+	unsigned long long seenGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			jobReady.wait(lock, [&] { return stopping || jobGeneration != seenGeneration; });
+			if (stopping)
+				return;
+			seenGeneration = jobGeneration;
+		}
+
+		while (runOne(index))
+			;
+	}
+}
+
+bool ThreadPool::runOne(int index)
+{
+	std::pair<int, int> range;
+	bool found = false;
+
+	{
+		WorkQueue& own = *queues[index];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.ranges.empty())
+		{
+			range = own.ranges.front();
+			own.ranges.pop_front();
+			found = true;
+		}
+	}
+
+	// steal from the back, the end furthest from where the owner is working
+	for (int offset = 1; !found && offset < getThreadCount(); offset++)
+	{
+		WorkQueue& victim = *queues[(index + offset) % getThreadCount()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.ranges.empty())
+		{
+			range = victim.ranges.back();
+			victim.ranges.pop_back();
+			found = true;
+			steals++;
+		}
+	}
+
+	if (!found)
+		return false;
+
+	(*body)(range.first, range.second);
+	pendingRanges--;
+	return true;
+}
@@ -0,0 +1,130 @@
+#include "headers/vertex_format.h"
+#include "headers/mesh.h"
+
+#include "glm/gtc/packing.hpp"
+
+#include <cstring>
+
+// byte sizes of the packed attributes
+static const unsigned int POSITION_SIZE = 3 * sizeof(float);
+static const unsigned int NORMAL_SIZE = sizeof(glm::uint32);
+static const unsigned int UV_SIZE = sizeof(glm::uint32);
+static const unsigned int TANGENT_SIZE = sizeof(glm::uint32);
+static const unsigned int BONE_IDS_SIZE = MAX_BONE_INFLUENCE * sizeof(unsigned short);
+static const unsigned int BONE_WEIGHTS_SIZE = MAX_BONE_INFLUENCE * sizeof(unsigned char);
+
+unsigned int VertexLayout::stride() const
+{
+	if (!packed)
+		return sizeof(Vertex);
+
+	unsigned int size = POSITION_SIZE + NORMAL_SIZE + UV_SIZE;
+	if (tangents)
+		size += TANGENT_SIZE;
+	if (bones)
+		size += BONE_IDS_SIZE + BONE_WEIGHTS_SIZE;
+	return size;
+}
+
+static void write(unsigned char*& target, const void* source, size_t size)
+{
+	std::memcpy(target, source, size);
+	target += size;
+}
+
+void packVertices(const Vertex* vertices, size_t count, const VertexLayout& layout, std::vector<unsigned char>& out)
+{
+	out.resize(count * layout.stride());
+	if (count == 0)
+		return;
+	if (!layout.packed)
+	{
+		std::memcpy(&out[0], vertices, count * sizeof(Vertex));
+		return;
+	}
+
+	unsigned char* target = &out[0];
+	for (size_t i = 0; i < count; i++)
+	{
+		const Vertex& vertex = vertices[i];
+		write(target, &vertex.Position, POSITION_SIZE);
+
+		glm::uint32 normal = glm::packSnorm3x10_1x2(glm::vec4(vertex.Normal, 0.0f));
+		write(target, &normal, NORMAL_SIZE);
+
+		glm::uint32 uv = glm::packHalf2x16(vertex.TexCoords);
+		write(target, &uv, UV_SIZE);
+
+		if (layout.tangents)
+		{
+			// handedness of the tangent frame, the bitangent itself is not stored
+			float sign = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+			glm::uint32 tangent = glm::packSnorm3x10_1x2(glm::vec4(vertex.Tangent, sign));
+			write(target, &tangent, TANGENT_SIZE);
+		}
+
+		if (layout.bones)
+		{
+			unsigned short ids[MAX_BONE_INFLUENCE];
+			unsigned char weights[MAX_BONE_INFLUENCE];
+			for (int k = 0; k < MAX_BONE_INFLUENCE; k++)
+			{
+				bool used = vertex.m_BoneIDs[k] >= 0;
+				ids[k] = used ? (unsigned short)vertex.m_BoneIDs[k] : 0;
+				weights[k] = used ? (unsigned char)(glm::clamp(vertex.m_Weights[k], 0.0f, 1.0f) * 255.0f + 0.5f) : 0;
+			}
+			write(target, ids, BONE_IDS_SIZE);
+			write(target, weights, BONE_WEIGHTS_SIZE);
+		}
+	}
+}
+
+void setVertexAttributes(const VertexLayout& layout)
+{
+	GLsizei stride = layout.stride();
+
+	if (!layout.packed)
+	{
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Normal));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, TexCoords));
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Tangent));
+		glEnableVertexAttribArray(4);
+		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Bitangent));
+		glEnableVertexAttribArray(5);
+		glVertexAttribIPointer(5, 4, GL_INT, stride, (void*)offsetof(Vertex, m_BoneIDs));
+		glEnableVertexAttribArray(6);
+		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, m_Weights));
+		return;
+	}
+
+	size_t offset = 0;
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+	offset += POSITION_SIZE;
+	// GL 4.0 maps the 10 bit snorm values with (2c + 1) / 1023, close enough since the shaders normalize
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offset);
+	offset += NORMAL_SIZE;
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offset);
+	offset += UV_SIZE;
+	if (layout.tangents)
+	{
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offset);
+		offset += TANGENT_SIZE;
+	}
+	if (layout.bones)
+	{
+		glEnableVertexAttribArray(5);
+		glVertexAttribIPointer(5, 4, GL_UNSIGNED_SHORT, stride, (void*)offset);
+		offset += BONE_IDS_SIZE;
+		glEnableVertexAttribArray(6);
+		glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offset);
+	}
+}